@@ -1,10 +1,25 @@
+// Screen.c
+// Un hilo de simulacion por figura + render en el hilo principal.
+// Por defecto la simulacion publica cada tick en un triple buffer por figura y el
+// render lee la ultima instantanea completa, sin locks. Con -DSCREEN_USE_MUTEX se
+// compila el esquema anterior (mutex por figura) para comparar.
+// Compilacion:
+//   gcc Screen.c -o screen -O2 -pthread `sdl2-config --cflags --libs`
+//   gcc Screen.c -o screen_mutex -O2 -pthread -DSCREEN_USE_MUTEX `sdl2-config --cflags --libs`
+// Al salir imprime la espera por el lock y el tiempo con el lock tomado (o el tiempo de
+// publicar y leer el triple buffer) y el jitter del loop de render.
+// Un hilo por figura no escala a cientos de figuras: para eso mystify --mode pool usa un
+// pool fijo de hilos con robo de trabajo y una barrera por frame.
 
 #include <SDL2/SDL.h>
 #include <pthread.h>
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #define NUM_SHAPES 5
 #define POINTS_PER_SHAPE 6
@@ -14,15 +29,36 @@ typedef struct {
     float x, y, vx, vy;
 } Point;
 
+// Triple buffer: el escritor llena buf[back] y lo intercambia con el del medio;
+// el lector toma el del medio solo si hay uno nuevo (bit FRESH). Nadie espera.
+#define TB_FRESH 4u
 typedef struct {
-    Point points[POINTS_PER_SHAPE];
+    Point buf[3][POINTS_PER_SHAPE];
+    atomic_uint middle;     // indice del buffer del medio | TB_FRESH
+    unsigned back;          // solo el hilo de simulacion
+    unsigned front;         // solo el hilo de render
+} TripleBuffer;
+
+// Tiempos en ticks de SDL_GetPerformanceCounter; cada contador lo escribe un solo hilo.
+typedef struct {
+    Uint64 sum, max, count;
+} HoldStats;
+
+typedef struct {
+    Point points[POINTS_PER_SHAPE];   // estado privado del hilo de simulacion
     SDL_Color color;
+#ifdef SCREEN_USE_MUTEX
     pthread_mutex_t lock;
+#else
+    TripleBuffer tb;
+#endif
+    HoldStats sim_wait;               // espera por el lock en la simulacion (mutex)
+    HoldStats sim_hold;               // lock tomado (o publicacion) en la simulacion
 } Shape;
 
 Shape shapes[NUM_SHAPES];
 int winW = 800, winH = 600;
-bool running = true;
+atomic_bool running = true;
 
 Uint32 palette[][3] = {
     {0,170,255}, {255,0,170}, {255,255,0},
@@ -34,13 +70,47 @@ float frand(float min, float max) {
     return min + (float)rand() / RAND_MAX * (max - min);
 }
 
+static void hold_add(HoldStats *h, Uint64 t) {
+    h->sum += t;
+    h->count++;
+    if (t > h->max) h->max = t;
+}
+
+#ifndef SCREEN_USE_MUTEX
+static void tb_init(TripleBuffer *tb, const Point *pts) {
+    for (int b=0; b<3; b++) memcpy(tb->buf[b], pts, sizeof(tb->buf[b]));
+    tb->back = 0;
+    atomic_init(&tb->middle, 1u);
+    tb->front = 2;
+}
+
+static void tb_publish(TripleBuffer *tb, const Point *pts) {
+    memcpy(tb->buf[tb->back], pts, sizeof(tb->buf[tb->back]));
+    unsigned prev = atomic_exchange_explicit(&tb->middle, tb->back | TB_FRESH, memory_order_acq_rel);
+    tb->back = prev & 3u;
+}
+
+static const Point *tb_latest(TripleBuffer *tb) {
+    if (atomic_load_explicit(&tb->middle, memory_order_relaxed) & TB_FRESH) {
+        unsigned prev = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+        tb->front = prev & 3u;
+    }
+    return tb->buf[tb->front];
+}
+#endif
+
 void *simulate(void *arg) {
     Shape *s = (Shape*)arg;
     Uint32 frameDelay = 1000 / SIM_FPS;
 
-    while (running) {
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
         Uint32 start = SDL_GetTicks();
+#ifdef SCREEN_USE_MUTEX
+        Uint64 w0 = SDL_GetPerformanceCounter();
         pthread_mutex_lock(&s->lock);
+        Uint64 h0 = SDL_GetPerformanceCounter();
+        hold_add(&s->sim_wait, h0 - w0);
+#endif
         for (int i=0; i<POINTS_PER_SHAPE; i++) {
             s->points[i].x += s->points[i].vx;
             s->points[i].y += s->points[i].vy;
@@ -48,7 +118,14 @@ void *simulate(void *arg) {
             if (s->points[i].x < 0 || s->points[i].x > winW) s->points[i].vx *= -1;
             if (s->points[i].y < 0 || s->points[i].y > winH) s->points[i].vy *= -1;
         }
+#ifdef SCREEN_USE_MUTEX
+        hold_add(&s->sim_hold, SDL_GetPerformanceCounter() - h0);
         pthread_mutex_unlock(&s->lock);
+#else
+        Uint64 h0 = SDL_GetPerformanceCounter();
+        tb_publish(&s->tb, s->points);
+        hold_add(&s->sim_hold, SDL_GetPerformanceCounter() - h0);
+#endif
 
         Uint32 elapsed = SDL_GetTicks() - start;
         if (elapsed < frameDelay) SDL_Delay(frameDelay - elapsed);
@@ -56,6 +133,43 @@ void *simulate(void *arg) {
     return NULL;
 }
 
+static void hold_merge(HoldStats *dst, const HoldStats *h) {
+    dst->sum += h->sum;
+    dst->count += h->count;
+    if (h->max > dst->max) dst->max = h->max;
+}
+
+static void print_hold(const char *label, const char *unit, const HoldStats *h) {
+    double us = 1e6 / (double)SDL_GetPerformanceFrequency();
+    printf("  %-22s %llu %s, media %.3f us, max %.3f us\n", label, (unsigned long long)h->count, unit,
+           h->count ? h->sum*us/h->count : 0.0, h->max*us);
+}
+
+static void print_stats(const HoldStats *render_wait, const HoldStats *render_hold,
+                        double jit_mean, double jit_m2, double jit_max, Uint64 frames) {
+    HoldStats sim_wait = {0, 0, 0}, sim_hold = {0, 0, 0};
+    for (int s=0; s<NUM_SHAPES; s++) {
+        hold_merge(&sim_wait, &shapes[s].sim_wait);
+        hold_merge(&sim_hold, &shapes[s].sim_hold);
+    }
+#ifdef SCREEN_USE_MUTEX
+    // La espera es el bloqueo que evita el triple buffer; lo tomado incluye el trabajo
+    printf("[STATS] lock (mutex)\n");
+    print_hold("simulacion, espera:", "ticks", &sim_wait);
+    print_hold("simulacion, tomado:", "ticks", &sim_hold);
+    print_hold("render, espera:", "lecturas", render_wait);
+    print_hold("render, tomado:", "lecturas", render_hold);
+#else
+    (void)render_wait;
+    printf("[STATS] publicacion/lectura (triple buffer, sin espera)\n");
+    print_hold("simulacion, publicar:", "ticks", &sim_hold);
+    print_hold("render, tb_latest:", "lecturas", render_hold);
+#endif
+    double sd = frames > 1 ? sqrt(jit_m2 / (double)(frames-1)) : 0.0;
+    printf("[STATS] intervalo entre presents: media %.3f ms, desv. %.3f ms, max %.3f ms (%llu frames)\n",
+           jit_mean, sd, jit_max, (unsigned long long)frames);
+}
+
 int main(int argc, char *argv[]) {
     srand(time(NULL));
     SDL_Init(SDL_INIT_VIDEO);
@@ -78,40 +192,78 @@ int main(int argc, char *argv[]) {
         shapes[s].color.g = palette[ci][1];
         shapes[s].color.b = palette[ci][2];
         shapes[s].color.a = 255;
+#ifdef SCREEN_USE_MUTEX
         pthread_mutex_init(&shapes[s].lock, NULL);
+#else
+        tb_init(&shapes[s].tb, shapes[s].points);
+#endif
         pthread_create(&threads[s], NULL, simulate, &shapes[s]);
     }
 
+    HoldStats render_wait = {0, 0, 0}, render_hold = {0, 0, 0};
+    double pfreq_ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    Uint64 last_present = 0, frames = 0;
+    double jit_mean = 0.0, jit_m2 = 0.0, jit_max = 0.0;
+
     SDL_Event e;
-    while (running) {
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
         while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_QUIT) running = false;
-            if (e.type == SDL_KEYDOWN || e.type == SDL_MOUSEBUTTONDOWN) running = false;
+            if (e.type == SDL_QUIT) atomic_store(&running, false);
+            if (e.type == SDL_KEYDOWN || e.type == SDL_MOUSEBUTTONDOWN) atomic_store(&running, false);
         }
 
         SDL_SetRenderDrawColor(renderer, 3, 3, 6, 255);
         SDL_RenderClear(renderer);
 
         for (int s=0; s<NUM_SHAPES; s++) {
+#ifdef SCREEN_USE_MUTEX
+            Uint64 w0 = SDL_GetPerformanceCounter();
             pthread_mutex_lock(&shapes[s].lock);
+            Uint64 h0 = SDL_GetPerformanceCounter();
+            hold_add(&render_wait, h0 - w0);
+            const Point *P = shapes[s].points;
+#else
+            Uint64 h0 = SDL_GetPerformanceCounter();
+            const Point *P = tb_latest(&shapes[s].tb);
+            hold_add(&render_hold, SDL_GetPerformanceCounter() - h0);
+#endif
             SDL_SetRenderDrawColor(renderer, shapes[s].color.r, shapes[s].color.g, shapes[s].color.b, 255);
             for (int i=0; i<POINTS_PER_SHAPE; i++) {
                 int j = (i+1) % POINTS_PER_SHAPE;
                 SDL_RenderDrawLine(renderer,
-                    (int)shapes[s].points[i].x, (int)shapes[s].points[i].y,
-                    (int)shapes[s].points[j].x, (int)shapes[s].points[j].y);
+                    (int)P[i].x, (int)P[i].y,
+                    (int)P[j].x, (int)P[j].y);
             }
+#ifdef SCREEN_USE_MUTEX
+            hold_add(&render_hold, SDL_GetPerformanceCounter() - h0);
             pthread_mutex_unlock(&shapes[s].lock);
+#endif
         }
 
         SDL_RenderPresent(renderer);
+
+        // Jitter: intervalo entre presents (Welford)
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (last_present) {
+            double dt = (double)(now - last_present) * pfreq_ms;
+            frames++;
+            double d = dt - jit_mean;
+            jit_mean += d / (double)frames;
+            jit_m2 += d * (dt - jit_mean);
+            if (dt > jit_max) jit_max = dt;
+        }
+        last_present = now;
+
         SDL_Delay(16); // ~60 fps
     }
 
     for (int s=0; s<NUM_SHAPES; s++) {
         pthread_join(threads[s], NULL);
+#ifdef SCREEN_USE_MUTEX
         pthread_mutex_destroy(&shapes[s].lock);
+#endif
     }
+    print_stats(&render_wait, &render_hold, jit_mean, jit_m2, jit_max, frames);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
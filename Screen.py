@@ -1,8 +1,23 @@
+# Screen.py
+# Screensaver en pygame. Dos fuentes de estado:
+#   python Screen.py                  simulacion en procesos multiprocessing; cada tick
+#                                     se serializa la figura por un mp.Queue
+#   python Screen.py --shm /mystify   lee las posiciones que publica mystify.c --shm en
+#                                     memoria compartida (mmap + numpy, sin copias)
+# Comparacion de latencia y throughput entre ambos (sin pygame en pantalla):
+#   ./mystify --headless --shm /mystify --shapes 25 --points 6 --fps 45 --secs 60 --render cpu
+#   python Screen.py --bench-ipc /mystify
+# (con --fps 0 en mystify se mide el throughput maximo del lado shm)
+
 import os
 import sys
 import math
+import mmap
 import time
+import queue
 import random
+import struct
+import argparse
 import multiprocessing as mp
 from dataclasses import dataclass
 
@@ -20,6 +35,7 @@ SIM_FPS = 45            # FPS de simulación en procesos
 RENDER_FPS = 60         # FPS de render en el proceso principal
 LINE_THICKNESS = 2      # grosor de línea
 AA_LINES = True         # usar líneas anti-aliased
+BENCH_SECS = 5.0        # duracion de cada medicion de --bench-ipc
 
 # paleta clásica (Win95 vibes) + algunos tonos
 PALETTE = [
@@ -124,7 +140,72 @@ def simulate_shape(shape_id, screen_size, n_points, out_queue, stop_event, seed,
     # fin del proceso
 
 
-def run_screensaver():
+# ------------------ Memoria compartida (mystify --shm) ------------------
+# Mismo formato que ShmHeader/ShmShape en mystify.c.
+SHM_MAGIC = b"MYSTSHM\0"
+SHM_VERSION = 1
+SHM_STATIC = struct.Struct("<8s6I4Q")  # magic .. buf_offset[1]: partes fijas del header
+SHM_CTL_OFFSET = 64                    # frame, seq[2], stamp_ns[2], alive (uint64)
+SHM_SHAPE_DTYPE = [("first", "<u8"), ("n", "<u4"), ("r", "u1"), ("g", "u1"), ("b", "u1"), ("pal", "u1")]
+
+
+class ShmReader:
+    """Vistas numpy sobre el segmento de mystify --shm: leer un frame no copia nada.
+
+    Doble buffer versionado: latest() da el buffer del ultimo frame completo y
+    still_valid() confirma despues de usarlo que el productor no lo reescribio.
+    Las lecturas de 8 bytes alineadas son atomicas en x86-64 y ARM64.
+    """
+
+    def __init__(self, name):
+        import numpy as np
+        fd = os.open("/dev/shm/" + name.lstrip("/"), os.O_RDONLY)  # shm_open en Linux
+        try:
+            self.mm = mmap.mmap(fd, 0, access=mmap.ACCESS_READ)
+        finally:
+            os.close(fd)
+        (magic, version, _hdr, self.num_shapes, self.width, self.height, _res,
+         self.total, shapes_off, buf0, buf1) = SHM_STATIC.unpack_from(self.mm, 0)
+        if magic != SHM_MAGIC or version != SHM_VERSION:
+            self.mm.close()
+            raise RuntimeError(f"{name}: formato desconocido (magic {magic!r}, version {version})")
+        self.ctl = np.frombuffer(self.mm, dtype="<u8", count=6, offset=SHM_CTL_OFFSET)
+        self.shapes = np.frombuffer(self.mm, dtype=SHM_SHAPE_DTYPE, count=self.num_shapes, offset=shapes_off)
+        self.xy = [np.frombuffer(self.mm, dtype="<f4", count=2 * self.total, offset=off).reshape(-1, 2)
+                   for off in (buf0, buf1)]
+
+    def latest(self):
+        """(frame, buffer, version, xy) del ultimo frame publicado, o None si no hay."""
+        while True:
+            frame = int(self.ctl[0])
+            if frame == 0:
+                return None
+            b = (frame - 1) & 1
+            version = int(self.ctl[1 + b])
+            if version & 1:
+                continue  # el productor ya dio la vuelta: hay un frame mas nuevo
+            return frame, b, version, self.xy[b]
+
+    def still_valid(self, b, version):
+        return int(self.ctl[1 + b]) == version
+
+    def stamp_ns(self, b):
+        return int(self.ctl[3 + b])
+
+    def alive(self):
+        return bool(self.ctl[5])
+
+    def spans(self):
+        """[(first, n, color)] por figura; no cambian durante la corrida."""
+        return [(int(s["first"]), int(s["n"]), (int(s["r"]), int(s["g"]), int(s["b"]))) for s in self.shapes]
+
+    def close(self):
+        # las vistas numpy deben soltarse antes de cerrar el mmap
+        self.ctl = self.shapes = self.xy = None
+        self.mm.close()
+
+
+def run_screensaver(shm_name=None):
     # Pygame debe correr en el proceso principal
     os.environ["SDL_VIDEO_CENTERED"] = "1"
     pygame.init()
@@ -137,6 +218,13 @@ def run_screensaver():
 
     clock = pygame.time.Clock()
 
+    # Con --shm el estado viene de mystify.c; sin workers ni cola
+    reader = ShmReader(shm_name) if shm_name else None
+    shm_pts = None
+    if reader:
+        spans = reader.spans()
+        scale = (W / reader.width, H / reader.height)
+
     # Comunicación con procesos trabajadores
     ctx = mp.get_context("spawn")  # compatible con Windows
     stop_event = ctx.Event()
@@ -144,7 +232,7 @@ def run_screensaver():
 
     # iniciar workers
     workers = []
-    for sid in range(NUM_SHAPES):
+    for sid in range(NUM_SHAPES if reader is None else 0):
         p = ctx.Process(
             target=simulate_shape,
             args=(sid, (W, H), POINTS_PER_SHAPE, out_queue, stop_event, random.randrange(10**9), SIM_FPS),
@@ -187,6 +275,18 @@ def run_screensaver():
                 if abs(mx - mouse_origin[0]) > 5 or abs(my - mouse_origin[1]) > 5:
                     running = False
 
+        if reader:
+            # ultimo frame: el escalado a pantalla es la unica copia, y solo se usa
+            # si el productor no piso el buffer mientras tanto
+            got = reader.latest()
+            if got:
+                _, b, version, xy = got
+                pts = xy * scale
+                if reader.still_valid(b, version):
+                    shm_pts = pts
+            if not reader.alive():
+                running = False
+
         # vaciar cola con los últimos estados disponibles
         try:
             # leer todo lo disponible sin bloquear
@@ -201,7 +301,17 @@ def run_screensaver():
         screen.fill(BG)
         screen.blit(fade_surface, (0, 0))
 
-        for sid in range(NUM_SHAPES):
+        if shm_pts is not None:
+            for first, n, color in spans:
+                pts = shm_pts[first:first + n]
+                if AA_LINES:
+                    pygame.draw.aalines(screen, color, True, pts)
+                    if LINE_THICKNESS > 1:
+                        pygame.draw.lines(screen, color, True, pts, LINE_THICKNESS)
+                else:
+                    pygame.draw.lines(screen, color, True, pts, LINE_THICKNESS)
+
+        for sid in range(NUM_SHAPES if reader is None else 0):
             pts = shapes_points[sid]
             if not pts:
                 continue
@@ -228,12 +338,131 @@ def run_screensaver():
         p.join(timeout=0.5)
         if p.is_alive():
             p.terminate()
+    if reader:
+        reader.close()
 
     pygame.quit()
 
 
+# ------------------ Benchmark IPC: mp.Queue vs memoria compartida ------------------
+def queue_producer(shape_id, n_points, out_queue, stop_event, seed, rate):
+    """Como simulate_shape, con marca de tiempo en cada mensaje; rate 0 = sin pausa."""
+    rng = random.Random(seed)
+    w, h = 1280, 720
+    state = create_random_shape(w, h, n_points, rng)
+    dt = 1.0 / rate if rate else 1.0 / SIM_FPS
+    next_t = time.perf_counter()
+    while not stop_event.is_set():
+        if rate:
+            next_t += dt
+            pause = next_t - time.perf_counter()
+            if pause > 0:
+                time.sleep(pause)
+        pts, vels = [], []
+        for (x, y), (vx, vy) in zip(state.points, state.vels):
+            x, y, vx, vy = bounce_point(x + vx * dt, y + vy * dt, vx, vy, w, h)
+            pts.append((x, y))
+            vels.append((vx, vy))
+        state.points, state.vels = pts, vels
+        try:
+            out_queue.put_nowait((shape_id, state.points, state.color_idx, time.monotonic_ns()))
+        except Exception:
+            pass
+
+
+def percentiles_ms(lat_ns):
+    if not lat_ns:
+        return 0.0, 0.0
+    lat = sorted(lat_ns)
+    pick = lambda p: lat[min(len(lat) - 1, int(p * len(lat)))] / 1e6
+    return pick(0.50), pick(0.99)
+
+
+def bench_queue(secs, rate):
+    ctx = mp.get_context("spawn")
+    stop_event = ctx.Event()
+    out_queue = ctx.Queue(maxsize=64)
+    workers = [ctx.Process(target=queue_producer,
+                           args=(sid, POINTS_PER_SHAPE, out_queue, stop_event, random.randrange(10**9), rate),
+                           daemon=True) for sid in range(NUM_SHAPES)]
+    for p in workers:
+        p.start()
+    out_queue.get()  # el tiempo corre desde el primer mensaje (spawn es lento)
+    lat, points = [], 0
+    t0 = time.perf_counter()
+    while time.perf_counter() - t0 < secs:
+        try:
+            _, pts, _, t_ns = out_queue.get(timeout=0.1)
+        except queue.Empty:
+            continue
+        lat.append(time.monotonic_ns() - t_ns)
+        points += len(pts)
+    elapsed = time.perf_counter() - t0
+    stop_event.set()
+    for p in workers:
+        p.join(timeout=0.5)
+        if p.is_alive():
+            p.terminate()
+    return lat, points / elapsed
+
+
+def bench_shm(name, secs):
+    reader = ShmReader(name)
+    lat, points, torn, last = [], 0, 0, 0
+    t0 = time.perf_counter()
+    while time.perf_counter() - t0 < secs and reader.alive():
+        got = reader.latest()
+        if not got or got[0] == last:
+            continue
+        frame, b, version, xy = got
+        now = time.monotonic_ns()
+        stamp = reader.stamp_ns(b)
+        xy.min(axis=0)  # consumir el frame: recorre todos los puntos sin copiarlos
+        if not reader.still_valid(b, version):
+            torn += 1
+            continue
+        lat.append(now - stamp)
+        points += reader.total
+        last = frame
+    elapsed = time.perf_counter() - t0
+    info = (reader.num_shapes, reader.total)
+    reader.close()
+    return lat, points / elapsed, torn, info
+
+
+def bench_ipc(shm_name, secs):
+    lat, pps = bench_queue(secs, SIM_FPS)
+    p50, p99 = percentiles_ms(lat)
+    print(f"[IPC] queue {NUM_SHAPES} procesos x {POINTS_PER_SHAPE} pts a {SIM_FPS} Hz: "
+          f"latencia p50 {p50:.3f} ms p99 {p99:.3f} ms | {pps:,.0f} puntos/s")
+    lat, pps = bench_queue(secs, 0)
+    p50, p99 = percentiles_ms(lat)
+    print(f"[IPC] queue {NUM_SHAPES} procesos sin pausa: "
+          f"latencia p50 {p50:.3f} ms p99 {p99:.3f} ms | {pps:,.0f} puntos/s")
+    if not shm_name:
+        print("[IPC] shm: sin segmento (python Screen.py --bench-ipc /mystify con mystify --shm corriendo)")
+        return
+    try:
+        lat, pps, torn, (n_shapes, total) = bench_shm(shm_name, secs)
+    except (OSError, RuntimeError) as e:
+        print(f"[IPC] shm: no se pudo abrir {shm_name}: {e}")
+        return
+    p50, p99 = percentiles_ms(lat)
+    print(f"[IPC] shm {n_shapes} figuras, {total} pts por frame: "
+          f"latencia p50 {p50:.3f} ms p99 {p99:.3f} ms | {pps:,.0f} puntos/s | {torn} frames pisados")
+
+
 if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Screensaver mystify en pygame")
+    parser.add_argument("--shm", metavar="NOMBRE", help="leer posiciones de mystify --shm NOMBRE")
+    parser.add_argument("--bench-ipc", metavar="NOMBRE", nargs="?", const="",
+                        help="medir mp.Queue contra memoria compartida (NOMBRE de mystify --shm)")
+    parser.add_argument("--secs", type=float, default=BENCH_SECS, help="segundos por medicion de --bench-ipc")
+    args = parser.parse_args()
     try:
-        run_screensaver()
+        if args.bench_ipc is not None:
+            bench_ipc(args.bench_ipc, args.secs)
+        else:
+            run_screensaver(args.shm)
     except KeyboardInterrupt:
         pass
@@ -1,5 +1,15 @@
+// main.c
+// Restaurante con OpenMP: parallel for + reduction y parallel sections.
+// Compilacion: gcc main.c -o main -O2 -fopenmp
+// Uso:
+//   ./main                      demo (imprime cada mesa y cada tarea)
+//   ./main --bench [reps] [trabajo]
+//       micro-benchmark sin printf: mide el costo por jornada de serial, for,
+//       sections, for+sections y el mismo trabajo como grafo de tareas con depend.
+//       'trabajo' es cuantas iteraciones de calculo hace cada tarea (0 = solo overhead).
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <omp.h>
 #include <time.h>
 
@@ -11,6 +21,7 @@ void atenderMesa(int idMesa, float precio);
 void cocinarPedidos(int numMesas);
 void cobrarPedidos(int numMesas);
 void recogerPlatos(int numMesas); // Nueva tarea para sections
+int benchJornada(int reps, int trabajo);
 
 // Genera un precio aleatorio entre 5 y 25
 float precioAleatorio() {
@@ -37,7 +48,125 @@ void recogerPlatos(int numMesas) {
     printf("Mesero: recogiendo platos de %d mesas...\n", numMesas);
 }
 
-int main() {
+// __________________________
+// MICRO-BENCHMARK (--bench)
+// __________________________
+// Cada tarea hace 'trabajo' iteraciones de un calculo que el compilador no puede
+// eliminar; con trabajo 0 lo medido es solo el costo de crear y sincronizar hilos.
+#define BENCH_MESAS 20
+
+static double trabajar(float x, int trabajo) {
+    double acc = x;
+    for (int k = 0; k < trabajo; k++) acc = acc * 1.0000001 + 0.5;
+    return acc;
+}
+
+// Las mismas cuatro etapas de la jornada: atender (por mesa), cocinar, cobrar, recoger.
+// Cocinar y cobrar leen todos los pedidos; recoger va despues de cocinar.
+static void atenderB(float* pedidos, double* listo, int i, int trabajo) {
+    listo[i] = trabajar(pedidos[i], trabajo);
+}
+static double cocinarB(const double* listo, int n, int trabajo) {
+    double s = 0.0;
+    for (int i = 0; i < n; i++) s += listo[i];
+    return trabajar((float)s, trabajo);
+}
+static double cobrarB(const float* pedidos, int n, int trabajo) {
+    double s = 0.0;
+    for (int i = 0; i < n; i++) s += pedidos[i];
+    return trabajar((float)s, trabajo);
+}
+static double recogerB(double cocinado, int trabajo) {
+    return trabajar((float)cocinado, trabajo);
+}
+
+static volatile double sumidero;  // evita que se descarten los resultados
+
+int benchJornada(int reps, int trabajo) {
+    const int n = BENCH_MESAS;
+    float pedidos[BENCH_MESAS];
+    double listo[BENCH_MESAS];
+    for (int i = 0; i < n; i++) pedidos[i] = precioAleatorio();
+    const char* nombres[5] = { "serial", "for (mesas)", "sections (cocinar/cobrar/recoger)",
+                               "for + sections (jornada)", "tareas con depend" };
+    double us[5];
+
+    for (int v = 0; v < 5; v++) {
+        double t0 = omp_get_wtime();
+        for (int r = 0; r < reps; r++) {
+            double cocinado = 0.0, cobrado = 0.0, recogido = 0.0;
+            switch (v) {
+            case 0:  // serial
+                for (int i = 0; i < n; i++) atenderB(pedidos, listo, i, trabajo);
+                cocinado = cocinarB(listo, n, trabajo);
+                cobrado = cobrarB(pedidos, n, trabajo);
+                recogido = recogerB(cocinado, trabajo);
+                break;
+            case 1:  // solo el parallel for de las mesas
+                #pragma omp parallel for
+                for (int i = 0; i < n; i++) atenderB(pedidos, listo, i, trabajo);
+                break;
+            case 2:  // solo las sections (recoger espera a cocinar dentro de su section)
+                #pragma omp parallel sections
+                {
+                    #pragma omp section
+                    { cocinado = cocinarB(listo, n, trabajo); recogido = recogerB(cocinado, trabajo); }
+                    #pragma omp section
+                    { cobrado = cobrarB(pedidos, n, trabajo); }
+                }
+                break;
+            case 3:  // la jornada del demo: for, barrera, sections
+                #pragma omp parallel for
+                for (int i = 0; i < n; i++) atenderB(pedidos, listo, i, trabajo);
+                #pragma omp parallel sections
+                {
+                    #pragma omp section
+                    { cocinado = cocinarB(listo, n, trabajo); recogido = recogerB(cocinado, trabajo); }
+                    #pragma omp section
+                    { cobrado = cobrarB(pedidos, n, trabajo); }
+                }
+                break;
+            case 4:  // grafo: cada etapa espera solo lo que lee, sin barrera entre for y sections
+                #pragma omp parallel
+                #pragma omp single
+                {
+                    for (int i = 0; i < n; i++) {
+                        #pragma omp task depend(out: listo[i])
+                        atenderB(pedidos, listo, i, trabajo);
+                    }
+                    #pragma omp task depend(iterator(j=0:n), in: listo[j]) depend(out: cocinado)
+                    cocinado = cocinarB(listo, n, trabajo);
+                    #pragma omp task depend(out: cobrado)
+                    cobrado = cobrarB(pedidos, n, trabajo);
+                    #pragma omp task depend(in: cocinado) depend(out: recogido)
+                    recogido = recogerB(cocinado, trabajo);
+                }
+                break;
+            }
+            sumidero = cocinado + cobrado + recogido + listo[n-1];
+        }
+        us[v] = (omp_get_wtime() - t0) * 1e6 / reps;
+    }
+
+    printf("[BENCH] %d mesas | %d hilos | %d repeticiones | trabajo %d\n",
+           n, omp_get_max_threads(), reps, trabajo);
+    for (int v = 0; v < 5; v++)
+        printf("  %-36s %10.3f us/jornada\n", nombres[v], us[v]);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "--bench")) {
+        int reps = argc > 2 ? atoi(argv[2]) : 10000;
+        int trabajo = argc > 3 ? atoi(argv[3]) : 0;
+        if (reps < 1 || trabajo < 0) {
+            fprintf(stderr, "[ERR] uso: %s --bench [reps>=1] [trabajo>=0]\n", argv[0]);
+            return 2;
+        }
+        srand(time(NULL));
+        return benchJornada(reps, trabajo);
+    }
+
     srand(time(NULL)); // Semilla para números aleatorios
 
     int numMesas = 20;               // Número total de mesas en el restaurante
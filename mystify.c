@@ -2,6 +2,7 @@
 // Screensaver secuencial + OpenMP con SDL2, CLI, FPS y benchmark (CSV).
 // Compilación (Linux/Mac/WSL):
 //   gcc mystify.c -o mystify -O2 -fopenmp `sdl2-config --cflags --libs`
+//   (glibc < 2.34: agregar -lrt para shm_open)
 // Compilación (MinGW):
 //   gcc mystify.c -o mystify.exe -O2 -fopenmp -IC:\SDL2\include -LC:\SDL2\lib -lSDL2
 //
@@ -9,10 +10,116 @@
 //   ./mystify --shapes 200 --points 6 --mode seq
 //   ./mystify --shapes 200 --points 6 --mode omp
 //   ./mystify --bench --secs 10 --shapes 600 --points 6 --w 1280 --h 720
+//   ./mystify --headless --bench --secs 3 --reps 5 --threads 1,3,6,12 --shapes-list 1000,10000
+//   ./mystify --headless --shapes 20000 --points 128 --dist zipf:1.2 --schedule dynamic,16
+//   ./mystify --headless --seed 42 --frames 500 --mode seq   (y --mode omp: mismo checksum)
+//   ./mystify --headless --bench --secs 5 --shapes 20000 --points 16
+//   ./mystify --shapes 20000 --points 32 --layout soa
+//   ./mystify --shapes 2000 --points 8 --render batch
+//   ./mystify --shapes 10000 --points 6 --render cpu --trail 16 --trail-mode decay
+//   ./mystify --shapes 5000 --points 8 --export out.y4m --frames 10000 --seed 7
+//   ./mystify --headless --shapes 2000000 --points 6 --layout soa --hugepages --frames 50
+//   ./mystify --shapes 20000 --points 8 --tick 120 --fps 60
+//   ./mystify --headless --bench --collide points --shapes-list 1000,10000,100000 --points 4
+//   ./mystify --headless --shm /mystify --shapes 25 --points 6 --secs 60 --render cpu
+//     (y en otra terminal: python Screen.py --shm /mystify)
+//   ./mystify --headless --shapes 20000 --points 16 --frames 200 --trace trace.json --trace-counters
+//   ./mystify --shapes 20000 --points 6 --render cpu --frame tasks
+//   ./mystify --headless --shapes 200000 --points 6 --dist zipf:1.2 --mode pool
+//   ./mystify --shapes 5000 --points 6 --aa --thick 2.5
+//   ./mystify --headless --shapes 1000000 --points 8 --frames 5000 --save-state s.snap --checkpoint 500
+//   ./mystify --shapes 1000000 --points 8 --load-state s.snap
+//   ./mystify --headless --shapes 200000 --points 16 --dist zipf:1.2 --autotune
+//   ./mystify --shapes 100000 --points 6 --render cpu --sim analytic --seek 1000000
+//   ./mystify --shapes 200 --points 12 --fill nonzero --fill-alpha 96 --aa
 //
 // Notas:
 // - Si compilas sin OpenMP, el modo "omp" caerá en secuencial con aviso.
-// - El benchmark prueba hilos 1,2,4,8,... hasta omp_get_max_threads() y escribe bench.csv
+// - El benchmark prueba hilos 1,2,4,8,... hasta omp_get_max_threads() (o --threads) y escribe bench.csv
+// - --headless no inicializa video: renderiza con el renderer por software de SDL sobre
+//   una superficie en memoria y sin limite de FPS (sirve en maquinas sin display).
+// - --layout soa guarda todos los puntos en arreglos contiguos x/y/vx/vy alineados a
+//   64 bytes y actualiza con un kernel sin ramas vectorizable (omp simd).
+// - --render batch agrupa figuras por color de PALETTE (un cambio de color por grupo) y
+//   manda cada poligono cerrado en un solo SDL_RenderDrawLinesF; --render geom manda
+//   todas las aristas como quads de 1 px en pocas llamadas a SDL_RenderGeometry.
+// - --render cpu rasteriza en CPU: reparte las aristas en tiles de pantalla, pinta los
+//   tiles en paralelo (OpenMP) sobre un framebuffer ARGB propio y lo sube una vez por
+//   frame a una textura SDL_TEXTUREACCESS_STREAMING. --aa pinta las aristas con
+//   antialiasing estilo Wu (cobertura por distancia al eje de la linea) y --thick W les
+//   da W px de grosor; cada fila de la linea es un tramo contiguo que se mezcla con
+//   alpha en un loop omp simd, asi el costo no depende de llamadas de dibujo de SDL.
+// - --pipeline (omp) traslapa update y render: los hilos calculan el frame N+1 en un
+//   buffer trasero mientras el hilo principal dibuja el frame N; swap al final del frame.
+// - Tiempos con SDL_GetPerformanceCounter, separados en update/render/present. El
+//   benchmark descarta --warmup frames, repite --reps veces, reporta media, p50/p95/p99
+//   y desviacion, barre --threads 1,3,6,12 y --shapes-list/--points-list, y escribe
+//   bench.csv y bench.json.
+// - --dist uniform:A-B|zipf:S da a cada figura un numero distinto de puntos (carga
+//   desbalanceada); --schedule static|dynamic|guided[,chunk] y --loop shape|point
+//   eligen como se reparte el update entre hilos. El benchmark barre ambos.
+// - --seed S fija la escena: el init usa un RNG por contador (figura, punto) y corre en
+//   paralelo con el mismo resultado bit a bit para cualquier numero de hilos. Al final
+//   de cada corrida se imprime un checksum del estado; con --frames N se pueden comparar
+//   corridas SEQ y OMP.
+// - --trail N dibuja estelas de N frames. --trail-mode history guarda las ultimas N
+//   posiciones en un ring buffer preasignado y las dibuja con color atenuado (render
+//   legacy/batch/geom); --trail-mode decay no limpia el framebuffer del render cpu y
+//   atenua cada pixel con una multiplicacion vectorizada (como fade_surface de Screen.py;
+//   --trail 64 da su mismo alpha 18).
+// - --export out.y4m --frames N (o un patron PPM como out/f%05d.ppm) renderiza offline
+//   sin limite de FPS con el raster cpu; un hilo escritor vacia una cola acotada de
+//   buffers reutilizables mientras se calcula el frame siguiente. Reporta frames/s y MB/s.
+// - Hasta 4M figuras: Shape[], offsets y puntos van en una sola arena alineada a 64 bytes
+//   (--hugepages: 2 MB + MADV_HUGEPAGE). Las paginas se tocan primero con el mismo
+//   reparto schedule(static) del update (NUMA). Cada corrida reporta bytes/figura y GB/s
+//   del update ([MEM]) para ver cuando el update queda limitado por memoria.
+// - --tick HZ desacopla la simulacion del render: pasos fijos de 1/HZ s con acumulador
+//   (varios subpasos por frame si el render se atrasa, fusionados por bloque), render
+//   interpolado entre los dos ultimos pasos y pacing a --fps con espera precisa.
+//   Reporta pasos/s de simulacion y FPS de render por separado.
+// - --collide points|shapes hace chocar los puntos entre si (o solo puntos de figuras
+//   distintas) con radio --radius. Cada paso reconstruye en paralelo un grid uniforme
+//   (counting sort por celda) y revisa solo las 3x3 celdas vecinas: costo lineal en
+//   puntos a densidad fija, en vez de O(n^2). [COLLIDE] separa grid y resolucion.
+// - --shm /nombre publica las posiciones de cada frame en memoria compartida POSIX
+//   (doble buffer versionado, formato en ShmHeader) para que otro proceso, como
+//   Screen.py --shm, las lea sin copias. Con --shm, --fps limita tambien en headless.
+// - --trace trace.json registra por hilo el trabajo del update y la espera en su
+//   barrera, render, present y eventos en anillos por hilo y los vuelca en formato
+//   trace_event de Chrome; --trace-counters suma ciclos, instrucciones y fallos de LLC
+//   (perf_event_open). Apagado cuesta un salto por punto de medicion.
+// - --mode pool hace el update en un pool propio de hilos persistentes (tantos como
+//   hilos OpenMP, o nucleos sin OpenMP) en vez de un parallel for: cada frame reparte
+//   las figuras en un deque de rangos por hilo y los hilos sin trabajo roban la mitad
+//   de un rango ajeno; una barrera por epoca cierra el frame. El benchmark lo compara
+//   con OMP para cada --threads y layout.
+// - --frame tasks arma cada frame del render cpu como grafo de tareas OpenMP con
+//   depend: update por bloque de figuras -> raster de cada tile tras los bloques que
+//   lo tocan -> copia de cada fila de tiles a la textura, sin barreras globales.
+//   main.c --bench compara el costo de sections, for y tareas con depend.
+// - --save-state F guarda la escena al terminar (y cada --checkpoint K frames, desde un
+//   hilo de fondo) como una pagina de cabecera seguida de la arena tal cual; --load-state F
+//   la mapea con mmap y sigue desde ahi sin regenerar nada: el checksum tras N pasos
+//   cargados es el mismo que el de una corrida sin cortes. Con --bench, la fila
+//   "arranque" compara el init en frio contra la carga.
+// - --autotune mide el update con la escena real para varios numeros de hilos (incluidos
+//   los nucleos fisicos: con SMT usar todos los hilos logicos suele ser peor), schedules,
+//   chunks y --loop, y usa el mas rapido. El resultado se guarda en --tune-cache con
+//   clave modelo de CPU + tamaño del problema; las corridas siguientes no calibran.
+// - --sim analytic no avanza la simulacion: cada eje es una onda triangular (con el
+//   clamp de bounce()) y las posiciones del paso t se evaluan en O(1) por punto desde
+//   el estado inicial, que nunca se escribe; --seek N salta al paso N sin costo. Mueve
+//   24 bytes por punto y frame contra 32 del update por pasos, pero hace mucha mas
+//   cuenta y tarda mas; el benchmark muestra ambas cosas y mide el error contra
+//   bounce() en double (tolerancia 1e-3 px) y contra los pasos en float. Los pasos
+//   acumulan redondeo y la forma cerrada no, asi que su checksum es otro: [CHECK] lo
+//   marca con sim=analytic y no se compara con el de --sim step.
+// - --fill evenodd|nonzero rellena cada poligono (hasta 128 vertices) en el raster cpu,
+//   translucido segun --fill-alpha, sin triangular ni llamadas de SDL: cada figura arma
+//   una vez por frame su tabla de aristas y cada banda de pantalla (una fila de tiles)
+//   la recorre por scanlines con una tabla de aristas activas, en paralelo por bandas y
+//   antes de pintar los contornos. [FILL] y el benchmark reportan Mpx/s del relleno.
 
 #define _GNU_SOURCE
 #include <SDL2/SDL.h>
@@ -23,6 +130,22 @@
 #include <time.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <errno.h>
+#if defined(__unix__) || defined(__APPLE__)
+  #define HAVE_SHM 1
+  #include <sys/mman.h>   // madvise(MADV_HUGEPAGE) para --hugepages; shm_open/mmap para --shm
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+#include <stdatomic.h>
+#ifdef __linux__
+  #include <linux/perf_event.h>   // --trace-counters
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+#endif
+#ifdef __APPLE__
+  #include <sys/sysctl.h>   // modelo de CPU para --autotune
+#endif
 
 #ifdef _OPENMP
   #include <omp.h>
@@ -30,6 +153,7 @@
   // Sombra mínima para compilar sin OpenMP
   static inline int omp_get_max_threads(void){ return 1; }
   static inline int omp_get_thread_num(void){ return 0; }
+  static inline int omp_get_num_threads(void){ return 1; }
 #endif
 
 // ---------- Config por defecto ----------
@@ -38,43 +162,194 @@
 #define DEF_SHAPES 5
 #define DEF_POINTS 6
 #define DEF_SECS   0   // 0 = correr hasta cerrar.
+#define DEF_WARMUP 30
+#define DEF_REPS   3
+#define DEF_TRAIL  16
+#define TRAIL_MAX  64
+#define DEF_RADIUS 3   // radio de choque en px (--radius)
+#define DEF_FILL_ALPHA 128   // opacidad del relleno (--fill-alpha)
+#define MAX_LIST   32  // valores maximos en --threads/--shapes-list/--points-list
+#define TUNE_CACHE_DEF "mystify.tune"   // cache de --autotune (--tune-cache)
 
 // ---------- Tipos ----------
 typedef struct { float x, y, vx, vy; } Point;
 
 typedef struct {
-    Point* points;       // tamaño = points_per_shape
+    Point* points;       // tamaño = n (solo en LAYOUT_AOS)
     SDL_Color color;
+    uint8_t pal;         // indice del color en PALETTE (para agrupar en render)
+    int n;               // puntos de esta figura (3..128)
 } Shape;
 
-typedef enum { MODE_SEQ=0, MODE_OMP=1 } RunMode;
+typedef enum { MODE_SEQ=0, MODE_OMP=1, MODE_POOL=2 } RunMode;
+typedef enum { LAYOUT_AOS=0, LAYOUT_SOA=1 } Layout;
+typedef enum { RENDER_LEGACY=0, RENDER_BATCH=1, RENDER_GEOM=2, RENDER_CPU=3 } RenderPath;
+typedef enum { DIST_FIXED=0, DIST_UNIFORM=1, DIST_ZIPF=2 } PtsDist;
+typedef enum { SCHED_STATIC=0, SCHED_DYNAMIC=1, SCHED_GUIDED=2 } SchedKind;
+typedef enum { LOOP_SHAPE=0, LOOP_POINT=1 } LoopKind;
+typedef enum { TRAIL_HISTORY=0, TRAIL_DECAY=1 } TrailMode;
+typedef enum { COLLIDE_NONE=0, COLLIDE_POINTS=1, COLLIDE_SHAPES=2 } CollideKind;
+typedef enum { FRAME_FORK=0, FRAME_TASKS=1 } FrameKind;
+typedef enum { SIM_STEP=0, SIM_ANALYTIC=1 } SimKind;
+#define ANALYTIC_MAX_STEP 2147483648ULL   // --sim analytic: pasos < 2^31 (cocientes en int32)
+typedef enum { FILL_NONE=0, FILL_EVENODD=1, FILL_NONZERO=2 } FillRule;
+
+#define MAX_PTS 128
+// Tope de figuras: 2^22 deja EDGE_ID en 29 bits y los conteos del raster en int.
+#define MAX_SHAPES (1 << 22)
+// Id de arista para el raster: figura en los bits altos, punto (< MAX_PTS) en 7 bits.
+#define EDGE_ID(s,i) (((uint32_t)(s) << 7) | (uint32_t)(i))
+
+// Puntos por iteracion en el loop aplanado (--loop point).
+#define FLAT_BLOCK 1024
+// Bloque de puntos por iteracion paralela: multiplo de 16 floats (64 bytes),
+// asi cada hilo trabaja sobre lineas de cache completas.
+#define SOA_BLOCK 4096
+
+// Puntos en estructura de arreglos: el punto i de la figura s esta en first[s]+i.
+typedef struct {
+    float *x, *y, *vx, *vy;   // alineados a 64 bytes
+} PointsSoA;
+
+// Estado completo de la simulacion en cualquiera de los dos layouts.
+typedef struct {
+    Layout layout;
+    int num_shapes;
+    int max_pts;         // maximo de puntos en una figura
+    size_t total;        // puntos en total
+    size_t* first;       // num_shapes+1 offsets (prefijo de n) en el arreglo plano
+    Shape* shapes;       // color y n siempre; points solo en LAYOUT_AOS
+    Point* pool;         // LAYOUT_AOS: todos los puntos; shapes[s].points = pool + first[s]
+    PointsSoA soa;       // solo en LAYOUT_SOA
+    void* arena;         // una sola reserva con shapes, first y los puntos
+    size_t arena_bytes;
+    bool huge;           // arena alineada a 2 MB con MADV_HUGEPAGE
+    void* map;           // != NULL: la arena esta dentro de una instantanea mapeada
+    size_t map_bytes;
+} Scene;
 
 typedef struct {
     int winW, winH;
     int num_shapes;
     int points_per_shape;
     int secs;         // duración; 0 = infinito
+    int frames;       // frames medidos por corrida (tras el warmup); 0 = sin limite
+    uint64_t seed;    // semilla de la escena (--seed; si no, derivada de la hora)
     RunMode mode;
+    Layout layout;
+    RenderPath render;
+    PtsDist dist;     // puntos por figura: fijo (--points), uniforme o zipf
+    int dist_min, dist_max;
+    double zipf_s;
+    SchedKind sched;  // schedule(runtime) del update
+    int sched_chunk;  // 0 = default de OpenMP
+    LoopKind loop;    // update paralelo por figura o por bloques de puntos
+    int trail;        // frames de estela; 0 = sin estela
+    TrailMode trail_mode;
+    const char* export_path;   // --export: .y4m o patron printf para PPM; NULL = no
+    bool hugepages;   // arena con transparent huge pages (Linux)
+    int tick_hz;      // pasos de simulacion por segundo; 0 = un update por frame
+    int fps;          // tope de FPS con ventana; 0 = sin tope
+    CollideKind collide;   // choques entre puntos (o solo entre figuras distintas)
+    int radius;       // radio de choque en px
+    const char* shm_name;   // --shm: segmento POSIX (/nombre) con las posiciones; NULL = no
+    const char* trace_path; // --trace: JSON trace_event de Chrome al salir; NULL = sin trazas
+    bool trace_counters;    // --trace-counters: ciclos/instrucciones/LLC por evento (Linux)
+    FrameKind frame;  // fork/join por etapa o grafo de tareas con depend (render cpu)
+    bool aa;          // lineas con antialiasing (render cpu)
+    float thick;      // grosor de las lineas AA en px
+    FillRule fill;    // relleno de los poligonos (render cpu); FILL_NONE = solo contorno
+    int fill_alpha;   // opacidad del relleno (1..255)
+    const char* save_state;  // --save-state: instantanea al terminar (y cada --checkpoint)
+    const char* load_state;  // --load-state: escena inicial desde una instantanea
+    int checkpoint;   // frames entre instantaneas; 0 = solo al terminar
+    SimKind sim;      // update por pasos o forma cerrada evaluada en cada frame
+    uint64_t seek;    // --sim analytic: paso inicial (salto directo)
+    bool autotune;    // calibrar (o leer del cache) hilos, schedule y loop al arrancar
+    const char* tune_cache;  // archivo del cache de --autotune
     bool bench;
+    bool headless;    // sin ventana: superficie en memoria, sin limite de FPS
+    bool pipeline;    // update del frame N+1 en paralelo con el render del frame N
+    int warmup;       // frames descartados al inicio de cada corrida
+    int reps;         // repeticiones por configuracion en el benchmark
+    // Barridos del benchmark (n==0 => default)
+    int threads_list[MAX_LIST], n_threads;
+    int shapes_list[MAX_LIST], n_shapes_list;
+    int points_list[MAX_LIST], n_points_list;
 } Args;
 
 // ---------- Utilidades ----------
-static float frandf(float a, float b) {
-    return a + (float)rand() / (float)RAND_MAX * (b - a);
-}
-
 static void print_help(const char* prog){
     printf(
       "Uso: %s [opciones]\n"
-      "  --shapes N        Numero de figuras (1..50000). Default: %d\n"
+      "  --shapes N        Numero de figuras (1..4194304). Default: %d\n"
       "  --points M        Puntos por figura (3..128). Default: %d\n"
+      "  --dist D          Puntos por figura: fixed | uniform:A-B | zipf:S (3..--points,\n"
+      "                    cola pesada con exponente S). Default: fixed\n"
+      "  --schedule K[,C]  Schedule del update omp: static|dynamic|guided, chunk C opcional\n"
+      "  --loop shape|point  Update paralelo por figura o por bloques de puntos. Default: shape\n"
       "  --w W             Ancho ventana (>= 320). Default: %d\n"
       "  --h H             Alto ventana  (>= 240). Default: %d\n"
       "  --secs T          Segundos a ejecutar (0=infinito). Default: %d\n"
-      "  --mode seq|omp    Modo de ejecucion. Default: omp si disponible, si no seq\n"
+      "  --mode seq|omp|pool  Modo de ejecucion; pool: update en un pool de hilos propio con\n"
+      "                    robo de trabajo (el resto del frame como omp). Default: omp si\n"
+      "                    disponible, si no seq\n"
+      "  --layout aos|soa  Layout de puntos (arreglo de structs o struct de arreglos). Default: aos\n"
+      "  --render legacy|batch|geom|cpu  Camino de dibujo (linea a linea, por poligono, geometria\n"
+      "                    o rasterizador por tiles en CPU). Default: legacy\n"
       "  --bench           Corre benchmarks (CSV) variando hilos y modo\n"
+      "  --trail N         Estela de N frames (1..64). Default: sin estela\n"
+      "  --trail-mode M    history (ring buffer de posiciones) | decay (render cpu,\n"
+      "                    framebuffer persistente atenuado). Default: history\n"
+      "  --export P        Exporta --frames N cuadros a P (.y4m, o patron PPM como\n"
+      "                    out/f%%05d.ppm); implica --headless y --render cpu\n"
+      "  --tick HZ         Simulacion a paso fijo de 1/HZ s, render interpolado. Default: 0\n"
+      "                    (un update por frame)\n"
+      "  --fps N           Tope de FPS con ventana (0 = sin tope). Default: 60\n"
+      "  --collide K       Choques: none | points (punto contra punto) | shapes (solo entre\n"
+      "                    puntos de figuras distintas). Default: none\n"
+      "  --radius R        Radio de choque en px (1..64). Default: %d\n"
+      "  --shm NAME        Publica las posiciones en memoria compartida POSIX (ej. /mystify)\n"
+      "                    para front-ends externos (Screen.py --shm)\n"
+      "  --frame fork|tasks  Frame con fork/join por etapa o como grafo de tareas OpenMP\n"
+      "                    (update por bloque -> raster por tile -> copia por fila;\n"
+      "                    render cpu). Default: fork\n"
+      "  --aa              Lineas con antialiasing (cobertura estilo Wu, mezcla alpha\n"
+      "                    SIMD); implica --render cpu\n"
+      "  --thick W         Grosor de las lineas AA en px (0.5..32); implica --aa. Default: 1\n"
+      "  --fill R          Rellena cada poligono con la regla evenodd|nonzero (scanline por\n"
+      "                    bandas en paralelo, bajo los contornos); implica --render cpu\n"
+      "  --fill-alpha A    Opacidad del relleno (1..255). Default: %d\n"
+      "  --sim step|analytic  Update por pasos, o posiciones en forma cerrada (triangular)\n"
+      "                    evaluadas en cada frame desde el estado inicial, sin escribirlo.\n"
+      "                    analytic es la trayectoria exacta de bounce(): NO sigue a step,\n"
+      "                    que acumula redondeo en float (tras cientos de pasos hay puntos\n"
+      "                    a varios px) y su checksum no se compara. Default: step\n"
+      "  --seek N          Con --sim analytic: empieza directamente en el paso N (< 2^31)\n"
+      "  --save-state F    Guarda el estado de la simulacion en F al terminar (binario,\n"
+      "                    mapeable; se escribe a F.tmp y se renombra)\n"
+      "  --checkpoint K    Con --save-state: tambien cada K frames, desde un hilo de fondo\n"
+      "  --load-state F    Arranca desde la instantanea F (figuras, puntos y semilla salen\n"
+      "                    del archivo; con el mismo --layout se mapea sin copiar)\n"
+      "  --autotune        Elige hilos, --schedule y --loop midiendo el update al arrancar\n"
+      "                    (omp/pool); el resultado queda en --tune-cache por CPU y tamaño\n"
+      "  --tune-cache F    Cache de --autotune. Default: " TUNE_CACHE_DEF "\n"
+      "  --trace F         Trazas por hilo (update, barrera, render, present, eventos) en\n"
+      "                    formato trace_event de Chrome, escritas en F al salir\n"
+      "  --trace-counters  Con --trace: ciclos, instrucciones y fallos de LLC por evento\n"
+      "                    (perf_event_open, Linux)\n"
+      "  --hugepages       Arena de la escena con transparent huge pages (Linux)\n"
+      "  --headless        Sin ventana ni video: render en memoria, sin limite de FPS\n"
+      "  --pipeline        (omp) Update del siguiente frame en paralelo con el render actual\n"
+      "  --frames N        Termina tras N frames medidos (+ warmup). Default: sin limite\n"
+      "  --seed S          Semilla de la escena (reproducible). Default: segun la hora\n"
+      "  --warmup F        Frames descartados al inicio de cada corrida. Default: %d\n"
+      "  --reps N          Repeticiones por configuracion (bench). Default: %d\n"
+      "  --threads L       Lista de hilos a barrer (bench), ej. 1,3,6,12. Default: 1,2,4,...\n"
+      "  --shapes-list L   Lista de numeros de figuras a barrer (bench). Default: --shapes\n"
+      "  --points-list L   Lista de puntos por figura a barrer (bench). Default: --points\n"
       "  --help            Muestra esta ayuda\n",
-      prog, DEF_SHAPES, DEF_POINTS, DEF_WIN_W, DEF_WIN_H, DEF_SECS
+      prog, DEF_SHAPES, DEF_POINTS, DEF_WIN_W, DEF_WIN_H, DEF_SECS, DEF_RADIUS, DEF_FILL_ALPHA, DEF_WARMUP, DEF_REPS
     );
 }
 
@@ -87,13 +362,63 @@ static bool parse_int(const char* s, int* out){
     return true;
 }
 
+// Lista separada por comas: "1,3,6,12". Devuelve cuantos valores leyo (0 = error).
+static int parse_int_list(const char* s, int* out, int max){
+    int n = 0;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (char* tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")){
+        if (n >= max || !parse_int(tok, &out[n])) return 0;
+        n++;
+    }
+    return n;
+}
+
 static void parse_args(int argc, char** argv, Args* a){
     a->winW = DEF_WIN_W;
     a->winH = DEF_WIN_H;
     a->num_shapes = DEF_SHAPES;
     a->points_per_shape = DEF_POINTS;
     a->secs = DEF_SECS;
+    a->frames = 0;
+    a->seed = (uint64_t)time(NULL);
     a->bench = false;
+    a->headless = false;
+    a->pipeline = false;
+    a->warmup = DEF_WARMUP;
+    a->reps = DEF_REPS;
+    a->n_threads = a->n_shapes_list = a->n_points_list = 0;
+    a->layout = LAYOUT_AOS;
+    a->render = RENDER_LEGACY;
+    a->dist = DIST_FIXED;
+    a->dist_min = a->dist_max = 0;
+    a->zipf_s = 1.0;
+    a->sched = SCHED_STATIC;
+    a->sched_chunk = 0;
+    a->loop = LOOP_SHAPE;
+    a->trail = 0;
+    a->trail_mode = TRAIL_HISTORY;
+    a->export_path = NULL;
+    a->hugepages = false;
+    a->tick_hz = 0;
+    a->fps = 60;
+    a->collide = COLLIDE_NONE;
+    a->radius = DEF_RADIUS;
+    a->shm_name = NULL;
+    a->trace_path = NULL;
+    a->trace_counters = false;
+    a->frame = FRAME_FORK;
+    a->aa = false;
+    a->thick = 1.0f;
+    a->fill = FILL_NONE;
+    a->fill_alpha = DEF_FILL_ALPHA;
+    a->save_state = NULL;
+    a->load_state = NULL;
+    a->checkpoint = 0;
+    a->sim = SIM_STEP;
+    a->seek = 0;
+    a->autotune = false;
+    a->tune_cache = TUNE_CACHE_DEF;
 #ifdef _OPENMP
     a->mode = MODE_OMP;
 #else
@@ -117,9 +442,133 @@ static void parse_args(int argc, char** argv, Args* a){
             const char* m = argv[++i];
             if (!strcmp(m,"seq")) a->mode = MODE_SEQ;
             else if (!strcmp(m,"omp")) a->mode = MODE_OMP;
-            else { fprintf(stderr,"[ERR] --mode debe ser seq|omp\n"); exit(2); }
+            else if (!strcmp(m,"pool")) a->mode = MODE_POOL;
+            else { fprintf(stderr,"[ERR] --mode debe ser seq|omp|pool\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--layout") && i+1<argc){
+            const char* l = argv[++i];
+            if (!strcmp(l,"aos")) a->layout = LAYOUT_AOS;
+            else if (!strcmp(l,"soa")) a->layout = LAYOUT_SOA;
+            else { fprintf(stderr,"[ERR] --layout debe ser aos|soa\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--render") && i+1<argc){
+            const char* r = argv[++i];
+            if (!strcmp(r,"legacy")) a->render = RENDER_LEGACY;
+            else if (!strcmp(r,"batch")) a->render = RENDER_BATCH;
+            else if (!strcmp(r,"geom")) a->render = RENDER_GEOM;
+            else if (!strcmp(r,"cpu")) a->render = RENDER_CPU;
+            else { fprintf(stderr,"[ERR] --render debe ser legacy|batch|geom|cpu\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--dist") && i+1<argc){
+            const char* d = argv[++i];
+            if (!strcmp(d,"fixed")) a->dist = DIST_FIXED;
+            else if (sscanf(d, "uniform:%d-%d", &a->dist_min, &a->dist_max) == 2) a->dist = DIST_UNIFORM;
+            else if (sscanf(d, "zipf:%lf", &a->zipf_s) == 1 && a->zipf_s > 0.0) a->dist = DIST_ZIPF;
+            else { fprintf(stderr,"[ERR] --dist debe ser fixed|uniform:A-B|zipf:S\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--schedule") && i+1<argc){
+            char kind[16] = {0};
+            int chunk = 0;
+            int got = sscanf(argv[++i], "%15[a-z],%d", kind, &chunk);
+            if (got >= 1 && !strcmp(kind,"static")) a->sched = SCHED_STATIC;
+            else if (got >= 1 && !strcmp(kind,"dynamic")) a->sched = SCHED_DYNAMIC;
+            else if (got >= 1 && !strcmp(kind,"guided")) a->sched = SCHED_GUIDED;
+            else { fprintf(stderr,"[ERR] --schedule debe ser static|dynamic|guided[,chunk]\n"); exit(2); }
+            a->sched_chunk = (got == 2)? chunk : 0;
+        } else if (!strcmp(argv[i], "--loop") && i+1<argc){
+            const char* l = argv[++i];
+            if (!strcmp(l,"shape")) a->loop = LOOP_SHAPE;
+            else if (!strcmp(l,"point")) a->loop = LOOP_POINT;
+            else { fprintf(stderr,"[ERR] --loop debe ser shape|point\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--trail") && i+1<argc){
+            parse_int(argv[++i], &a->trail);
+        } else if (!strcmp(argv[i], "--trail-mode") && i+1<argc){
+            const char* t = argv[++i];
+            if (!strcmp(t,"history")) a->trail_mode = TRAIL_HISTORY;
+            else if (!strcmp(t,"decay")) a->trail_mode = TRAIL_DECAY;
+            else { fprintf(stderr,"[ERR] --trail-mode debe ser history|decay\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--export") && i+1<argc){
+            a->export_path = argv[++i];
+        } else if (!strcmp(argv[i], "--tick") && i+1<argc){
+            parse_int(argv[++i], &a->tick_hz);
+        } else if (!strcmp(argv[i], "--fps") && i+1<argc){
+            parse_int(argv[++i], &a->fps);
+        } else if (!strcmp(argv[i], "--collide") && i+1<argc){
+            const char* c = argv[++i];
+            if (!strcmp(c,"none")) a->collide = COLLIDE_NONE;
+            else if (!strcmp(c,"points")) a->collide = COLLIDE_POINTS;
+            else if (!strcmp(c,"shapes")) a->collide = COLLIDE_SHAPES;
+            else { fprintf(stderr,"[ERR] --collide debe ser none|points|shapes\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--radius") && i+1<argc){
+            parse_int(argv[++i], &a->radius);
+        } else if (!strcmp(argv[i], "--shm") && i+1<argc){
+            a->shm_name = argv[++i];
+        } else if (!strcmp(argv[i], "--frame") && i+1<argc){
+            const char* f = argv[++i];
+            if (!strcmp(f,"fork")) a->frame = FRAME_FORK;
+            else if (!strcmp(f,"tasks")) a->frame = FRAME_TASKS;
+            else { fprintf(stderr,"[ERR] --frame debe ser fork|tasks\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--aa")){
+            a->aa = true;
+        } else if (!strcmp(argv[i], "--thick") && i+1<argc){
+            a->thick = (float)atof(argv[++i]);
+            a->aa = true;
+        } else if (!strcmp(argv[i], "--fill") && i+1<argc){
+            const char* f = argv[++i];
+            if (!strcmp(f,"evenodd")) a->fill = FILL_EVENODD;
+            else if (!strcmp(f,"nonzero")) a->fill = FILL_NONZERO;
+            else { fprintf(stderr,"[ERR] --fill debe ser evenodd|nonzero\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--fill-alpha") && i+1<argc){
+            parse_int(argv[++i], &a->fill_alpha);
+        } else if (!strcmp(argv[i], "--save-state") && i+1<argc){
+            a->save_state = argv[++i];
+        } else if (!strcmp(argv[i], "--load-state") && i+1<argc){
+            a->load_state = argv[++i];
+        } else if (!strcmp(argv[i], "--checkpoint") && i+1<argc){
+            parse_int(argv[++i], &a->checkpoint);
+        } else if (!strcmp(argv[i], "--sim") && i+1<argc){
+            const char* m = argv[++i];
+            if (!strcmp(m,"step")) a->sim = SIM_STEP;
+            else if (!strcmp(m,"analytic")) a->sim = SIM_ANALYTIC;
+            else { fprintf(stderr,"[ERR] --sim debe ser step|analytic\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--seek") && i+1<argc){
+            char* end = NULL;
+            a->seek = strtoull(argv[++i], &end, 0);
+            if (!end || *end){ fprintf(stderr,"[ERR] --seek espera un entero\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--autotune")){
+            a->autotune = true;
+        } else if (!strcmp(argv[i], "--tune-cache") && i+1<argc){
+            a->tune_cache = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && i+1<argc){
+            a->trace_path = argv[++i];
+        } else if (!strcmp(argv[i], "--trace-counters")){
+            a->trace_counters = true;
+        } else if (!strcmp(argv[i], "--hugepages")){
+            a->hugepages = true;
         } else if (!strcmp(argv[i], "--bench")){
             a->bench = true;
+        } else if (!strcmp(argv[i], "--headless")){
+            a->headless = true;
+        } else if (!strcmp(argv[i], "--pipeline")){
+            a->pipeline = true;
+        } else if (!strcmp(argv[i], "--frames") && i+1<argc){
+            parse_int(argv[++i], &a->frames);
+        } else if (!strcmp(argv[i], "--seed") && i+1<argc){
+            char* end = NULL;
+            a->seed = strtoull(argv[++i], &end, 0);
+            if (!end || *end){ fprintf(stderr,"[ERR] --seed espera un entero\n"); exit(2); }
+        } else if (!strcmp(argv[i], "--warmup") && i+1<argc){
+            parse_int(argv[++i], &a->warmup);
+        } else if (!strcmp(argv[i], "--reps") && i+1<argc){
+            parse_int(argv[++i], &a->reps);
+        } else if (!strcmp(argv[i], "--threads") && i+1<argc){
+            if (!(a->n_threads = parse_int_list(argv[++i], a->threads_list, MAX_LIST))){
+                fprintf(stderr,"[ERR] --threads espera una lista como 1,3,6,12\n"); exit(2);
+            }
+        } else if (!strcmp(argv[i], "--shapes-list") && i+1<argc){
+            if (!(a->n_shapes_list = parse_int_list(argv[++i], a->shapes_list, MAX_LIST))){
+                fprintf(stderr,"[ERR] --shapes-list espera una lista como 100,1000\n"); exit(2);
+            }
+        } else if (!strcmp(argv[i], "--points-list") && i+1<argc){
+            if (!(a->n_points_list = parse_int_list(argv[++i], a->points_list, MAX_LIST))){
+                fprintf(stderr,"[ERR] --points-list espera una lista como 6,32\n"); exit(2);
+            }
         } else {
             fprintf(stderr,"[ERR] Opcion no reconocida: %s\n", argv[i]);
             print_help(argv[0]); exit(2);
@@ -127,21 +576,197 @@ static void parse_args(int argc, char** argv, Args* a){
     }
 
     // Validaciones
-    if (a->num_shapes < 1 || a->num_shapes > 50000){
-        fprintf(stderr,"[ERR] --shapes fuera de rango (1..50000)\n"); exit(2);
+    if (a->num_shapes < 1 || a->num_shapes > MAX_SHAPES){
+        fprintf(stderr,"[ERR] --shapes fuera de rango (1..%d)\n", MAX_SHAPES); exit(2);
     }
-    if (a->points_per_shape < 3 || a->points_per_shape > 128){
+    if (a->points_per_shape < 3 || a->points_per_shape > MAX_PTS){
         fprintf(stderr,"[ERR] --points fuera de rango (3..128)\n"); exit(2);
     }
+    if (a->dist == DIST_UNIFORM &&
+        (a->dist_min < 3 || a->dist_max > MAX_PTS || a->dist_min > a->dist_max)){
+        fprintf(stderr,"[ERR] --dist uniform:A-B requiere 3 <= A <= B <= 128\n"); exit(2);
+    }
+    if (a->sched_chunk < 0){
+        fprintf(stderr,"[ERR] --schedule: chunk debe ser >= 0\n"); exit(2);
+    }
+    for (int k=0; k<a->n_shapes_list; k++){
+        if (a->shapes_list[k] < 1 || a->shapes_list[k] > MAX_SHAPES){
+            fprintf(stderr,"[ERR] --shapes-list fuera de rango (1..%d)\n", MAX_SHAPES); exit(2);
+        }
+    }
+    for (int k=0; k<a->n_points_list; k++){
+        if (a->points_list[k] < 3 || a->points_list[k] > 128){
+            fprintf(stderr,"[ERR] --points-list fuera de rango (3..128)\n"); exit(2);
+        }
+    }
+    for (int k=0; k<a->n_threads; k++){
+        if (a->threads_list[k] < 1){
+            fprintf(stderr,"[ERR] --threads: cada valor debe ser >= 1\n"); exit(2);
+        }
+    }
+    if (a->warmup < 0 || a->reps < 1){
+        fprintf(stderr,"[ERR] --warmup debe ser >= 0 y --reps >= 1\n"); exit(2);
+    }
     if (a->winW < 320 || a->winH < 240){
         fprintf(stderr,"[ERR] --w/--h muy pequeños (min 320x240)\n"); exit(2);
     }
+    if (a->trail < 0 || a->trail > TRAIL_MAX){
+        fprintf(stderr,"[ERR] --trail fuera de rango (0..64)\n"); exit(2);
+    }
+    if (a->export_path){
+        if (a->frames <= 0){ fprintf(stderr,"[ERR] --export requiere --frames N\n"); exit(2); }
+        if (a->bench){ fprintf(stderr,"[ERR] --export y --bench son excluyentes\n"); exit(2); }
+        // Offline: sin ventana, y los cuadros salen del framebuffer del raster cpu
+        a->headless = true;
+        a->render = RENDER_CPU;
+        if (a->trail > 0 && a->trail_mode == TRAIL_HISTORY){
+            fprintf(stderr,"[WARN] --export solo soporta --trail-mode decay; usando decay.\n");
+            a->trail_mode = TRAIL_DECAY;
+        }
+    }
+    if (a->trail > 0 && a->trail_mode == TRAIL_DECAY && a->render != RENDER_CPU){
+        fprintf(stderr,"[WARN] --trail-mode decay necesita el framebuffer propio; usando --render cpu.\n");
+        a->render = RENDER_CPU;
+    }
+    if (a->trail > 0 && a->trail_mode == TRAIL_HISTORY && a->render == RENDER_CPU){
+        fprintf(stderr,"[WARN] --trail-mode history dibuja con lineas SDL; usando --render batch.\n");
+        a->render = RENDER_BATCH;
+    }
+    if (a->tick_hz < 0 || a->tick_hz > 10000 || a->fps < 0 || a->fps > 1000){
+        fprintf(stderr,"[ERR] --tick fuera de rango (0..10000) o --fps fuera de rango (0..1000)\n"); exit(2);
+    }
+    if (a->tick_hz > 0 && a->pipeline && !a->bench){
+        fprintf(stderr,"[WARN] --tick no se combina con --pipeline; se ignora --pipeline.\n");
+        a->pipeline = false;
+    }
+    if (a->radius < 1 || a->radius > 64){
+        fprintf(stderr,"[ERR] --radius fuera de rango (1..64)\n"); exit(2);
+    }
+    if (a->collide != COLLIDE_NONE && a->pipeline && !a->bench){
+        // El grid necesita el paso completo antes de resolver; no se reparte por bloques
+        fprintf(stderr,"[WARN] --collide no se combina con --pipeline; se ignora --pipeline.\n");
+        a->pipeline = false;
+    }
+    if (a->shm_name && (a->shm_name[0] != '/' || strchr(a->shm_name+1, '/'))){
+        fprintf(stderr,"[ERR] --shm espera un nombre como /mystify (una sola '/', al inicio)\n"); exit(2);
+    }
+    if (a->thick < 0.5f || a->thick > 32.0f){
+        fprintf(stderr,"[ERR] --thick fuera de rango (0.5..32)\n"); exit(2);
+    }
+    if (a->aa && a->render != RENDER_CPU){
+        if (a->trail > 0 && a->trail_mode == TRAIL_HISTORY){
+            fprintf(stderr,"[WARN] --aa no se combina con --trail-mode history; se ignora --aa.\n");
+            a->aa = false;
+        } else {
+            fprintf(stderr,"[WARN] --aa rasteriza en CPU; usando --render cpu.\n");
+            a->render = RENDER_CPU;
+        }
+    }
+    if (a->fill_alpha < 1 || a->fill_alpha > 255){
+        fprintf(stderr,"[ERR] --fill-alpha fuera de rango (1..255)\n"); exit(2);
+    }
+    if (a->fill != FILL_NONE && a->render != RENDER_CPU){
+        if (a->trail > 0 && a->trail_mode == TRAIL_HISTORY){
+            fprintf(stderr,"[WARN] --fill no se combina con --trail-mode history; se ignora --fill.\n");
+            a->fill = FILL_NONE;
+        } else {
+            fprintf(stderr,"[WARN] --fill rasteriza en CPU; usando --render cpu.\n");
+            a->render = RENDER_CPU;
+        }
+    }
+    if (a->fill != FILL_NONE && a->frame == FRAME_TASKS){
+        // El relleno va por bandas de pantalla antes que los tiles; el grafo solo tiene tiles
+        fprintf(stderr,"[WARN] --fill no se combina con --frame tasks; usando --frame fork.\n");
+        a->frame = FRAME_FORK;
+    }
+    if (a->frame == FRAME_TASKS){
+        if (a->mode == MODE_POOL || a->pipeline || a->tick_hz > 0 || a->collide != COLLIDE_NONE ||
+            (a->trail > 0 && a->trail_mode == TRAIL_HISTORY)){
+            fprintf(stderr,"[WARN] --frame tasks no se combina con --mode pool, --pipeline, --tick, --collide ni "
+                           "--trail-mode history; usando --frame fork.\n");
+            a->frame = FRAME_FORK;
+        } else if (a->render != RENDER_CPU){
+            fprintf(stderr,"[WARN] --frame tasks rasteriza en CPU; usando --render cpu.\n");
+            a->render = RENDER_CPU;
+        }
+    }
+    if (a->checkpoint < 0 || (a->checkpoint > 0 && !a->save_state)){
+        fprintf(stderr,"[ERR] --checkpoint K requiere K >= 0 y --save-state F\n"); exit(2);
+    }
+    if (a->load_state && (a->n_shapes_list || a->n_points_list)){
+        fprintf(stderr,"[ERR] --load-state fija figuras y puntos; no se combina con --shapes-list/--points-list\n");
+        exit(2);
+    }
+    if (a->trace_counters && !a->trace_path){
+        fprintf(stderr,"[ERR] --trace-counters requiere --trace F\n"); exit(2);
+    }
+#ifndef __linux__
+    if (a->trace_counters){
+        fprintf(stderr,"[WARN] --trace-counters usa perf_event_open (Linux); se ignora.\n");
+        a->trace_counters = false;
+    }
+#endif
+#ifndef HAVE_SHM
+    if (a->shm_name){
+        fprintf(stderr,"[WARN] --shm requiere memoria compartida POSIX; se ignora.\n");
+        a->shm_name = NULL;
+    }
+#endif
+#ifndef __linux__
+    if (a->hugepages){
+        fprintf(stderr,"[WARN] --hugepages solo esta soportado en Linux; se ignora.\n");
+        a->hugepages = false;
+    }
+#endif
+    if (a->frames < 0){
+        fprintf(stderr,"[ERR] --frames debe ser >= 0\n"); exit(2);
+    }
+    if (a->headless && a->secs <= 0 && a->frames == 0 && !a->bench){
+        // Sin ventana no hay forma de cerrar: duracion finita obligatoria.
+        fprintf(stderr,"[WARN] --headless sin --secs; usando 8 s.\n");
+        a->secs = 8;
+    }
+#if !SDL_VERSION_ATLEAST(2,0,18)
+    if (a->render==RENDER_GEOM){
+        fprintf(stderr,"[WARN] SDL_RenderGeometry requiere SDL >= 2.0.18; usando --render batch.\n");
+        a->render = RENDER_BATCH;
+    }
+#endif
 #ifndef _OPENMP
     if (a->mode==MODE_OMP){
         fprintf(stderr,"[WARN] OpenMP no disponible; usando modo secuencial.\n");
         a->mode = MODE_SEQ;
     }
 #endif
+    if (a->pipeline && a->mode!=MODE_OMP && !a->bench){
+        fprintf(stderr,"[WARN] --pipeline requiere --mode omp; se ignora.\n");
+        a->pipeline = false;
+    }
+    if (a->seek > 0 && a->sim != SIM_ANALYTIC){
+        fprintf(stderr,"[ERR] --seek N requiere --sim analytic\n"); exit(2);
+    }
+    if (a->seek >= ANALYTIC_MAX_STEP){
+        fprintf(stderr,"[ERR] --seek debe ser < 2^31\n"); exit(2);
+    }
+    if (a->sim == SIM_ANALYTIC &&
+        (a->tick_hz > 0 || a->collide != COLLIDE_NONE || a->pipeline || a->frame == FRAME_TASKS)){
+        // Choques y paso fijo necesitan el estado de cada paso; pipeline y tareas fusionan el update
+        fprintf(stderr,"[WARN] --sim analytic no se combina con --tick, --collide, --pipeline ni "
+                       "--frame tasks; usando --sim step.\n");
+        a->sim = SIM_STEP;
+        a->seek = 0;
+    }
+#ifndef _OPENMP
+    if (a->autotune){
+        fprintf(stderr,"[WARN] --autotune elige hilos de OpenMP; sin OpenMP se ignora.\n");
+        a->autotune = false;
+    }
+#endif
+    if (a->autotune && (a->bench || a->mode == MODE_SEQ)){
+        fprintf(stderr,"[WARN] --autotune ajusta una corrida omp o pool (el benchmark ya barre hilos y "
+                       "schedules); se ignora.\n");
+        a->autotune = false;
+    }
 }
 
 // ---------- Datos / inicialización ----------
@@ -151,236 +776,4336 @@ static const uint8_t PALETTE[][3] = {
 };
 static const int PALETTE_SIZE = sizeof(PALETTE)/sizeof(PALETTE[0]);
 
-static void init_shapes(Shape* shapes, int num_shapes, int pts, int w, int h){
-    for (int s=0; s<num_shapes; s++){
-        shapes[s].points = (Point*)malloc(sizeof(Point)*pts);
-        if (!shapes[s].points){ fprintf(stderr,"[ERR] sin memoria (points)\n"); exit(3); }
-        for (int i=0;i<pts;i++){
-            shapes[s].points[i].x  = frandf(50.0f, (float)w-50.0f);
-            shapes[s].points[i].y  = frandf(50.0f, (float)h-50.0f);
-            float ang = frandf(0.0f, (float)M_PI*2.0f);
-            float spd = frandf(2.0f, 5.0f);
-            shapes[s].points[i].vx = cosf(ang)*spd;
-            shapes[s].points[i].vy = sinf(ang)*spd;
+// RNG por contador (SplitMix64): cada valor depende solo de (semilla, figura, punto,
+// campo), asi que el init da lo mismo en cualquier orden y con cualquier numero de hilos.
+enum { RNG_X=0, RNG_Y, RNG_ANG, RNG_SPD, RNG_COLOR, RNG_NPTS };
+
+static inline uint64_t mix64(uint64_t z){
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rng_at(uint64_t key, int s, int i, int field){
+    uint64_t ctr = ((uint64_t)(uint32_t)s << 32) | ((uint64_t)(uint32_t)i << 8) | (uint64_t)field;
+    return mix64(key ^ mix64(ctr));
+}
+
+// Uniforme en [0,1) con 24 bits (exacto en float).
+static inline float rng_unit(uint64_t r){ return (float)(r >> 40) * (1.0f/16777216.0f); }
+
+static inline float rng_range(uint64_t key, int s, int i, int field, float a, float b){
+    return a + rng_unit(rng_at(key, s, i, field)) * (b - a);
+}
+
+static Point rand_point(uint64_t key, int s, int i, int w, int h){
+    Point p;
+    p.x  = rng_range(key, s, i, RNG_X, 50.0f, (float)w-50.0f);
+    p.y  = rng_range(key, s, i, RNG_Y, 50.0f, (float)h-50.0f);
+    float ang = rng_range(key, s, i, RNG_ANG, 0.0f, (float)M_PI*2.0f);
+    float spd = rng_range(key, s, i, RNG_SPD, 2.0f, 5.0f);
+    p.vx = cosf(ang)*spd;
+    p.vy = sinf(ang)*spd;
+    return p;
+}
+
+static void rand_color(Shape* sh, uint64_t key, int s){
+    int ci = (int)(rng_at(key, s, 0, RNG_COLOR) % (uint64_t)PALETTE_SIZE);
+    sh->pal = (uint8_t)ci;
+    sh->color.r = PALETTE[ci][0];
+    sh->color.g = PALETTE[ci][1];
+    sh->color.b = PALETTE[ci][2];
+    sh->color.a = 255;
+}
+
+// CDF de la "zipf" truncada sobre n en [3, nmax]: P(n) proporcional a 1/(n-2)^s.
+// Casi todas las figuras quedan chicas y unas pocas llegan a nmax.
+static double ZIPF_CDF[MAX_PTS+1];
+
+static void zipf_table(double s_exp, int nmax){
+    double acc = 0.0;
+    for (int n=3; n<=nmax; n++){ acc += 1.0/pow((double)(n-2), s_exp); ZIPF_CDF[n] = acc; }
+    for (int n=3; n<=nmax; n++) ZIPF_CDF[n] /= acc;
+}
+
+// Para DIST_ZIPF, zipf_table() debe haberse llamado antes.
+static int rand_npoints(const Args* a, uint64_t key, int s){
+    uint64_t r = rng_at(key, s, 0, RNG_NPTS);
+    switch (a->dist){
+    case DIST_UNIFORM: return a->dist_min + (int)(r % (uint64_t)(a->dist_max - a->dist_min + 1));
+    case DIST_ZIPF: {
+        double u = (double)(r >> 11) * (1.0/9007199254740992.0);
+        for (int n=3; n<a->points_per_shape; n++) if (u < ZIPF_CDF[n]) return n;
+        return a->points_per_shape;
+    }
+    default:           return a->points_per_shape;
+    }
+}
+
+// Reserva alineada (64 bytes = linea de cache y ancho de AVX-512).
+static void* aligned_alloc64(size_t bytes){
+#ifdef _WIN32
+    void* p = _aligned_malloc(bytes, 64);
+#else
+    void* p = NULL;
+    if (posix_memalign(&p, 64, bytes) != 0) p = NULL;
+#endif
+    if (!p){ fprintf(stderr,"[ERR] sin memoria (aligned)\n"); exit(3); }
+    return p;
+}
+
+static void aligned_free64(void* p){
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// ---------- Arena de la escena ----------
+// Shape[], first[] y los puntos (AoS, o x/y/vx/vy en SoA) viven en una sola reserva,
+// cada bloque alineado a 64 bytes. Con --hugepages la arena se alinea a 2 MB y se
+// pide THP con madvise (Linux); se libera igual, con aligned_free64.
+#define HUGE_PAGE ((size_t)2 << 20)
+
+static inline size_t align64(size_t n){ return (n + 63) & ~(size_t)63; }
+
+static void* arena_alloc(size_t* bytes, bool huge){
+#ifdef __linux__
+    if (huge){
+        void* p = NULL;
+        *bytes = (*bytes + HUGE_PAGE-1) & ~(HUGE_PAGE-1);
+        if (posix_memalign(&p, HUGE_PAGE, *bytes) != 0){ fprintf(stderr,"[ERR] sin memoria (arena)\n"); exit(3); }
+        if (madvise(p, *bytes, MADV_HUGEPAGE) != 0)
+            fprintf(stderr,"[WARN] madvise(MADV_HUGEPAGE) fallo; la arena usa paginas normales.\n");
+        return p;
+    }
+#else
+    (void)huge;
+#endif
+    return aligned_alloc64(*bytes);
+}
+
+// Reparte la arena entre los bloques (base == NULL: solo calcula el tamaño).
+static size_t scene_carve(Scene* sc, char* base){
+    size_t off = 0, o_shapes, o_first, o_pts;
+    o_shapes = off; off += align64(sizeof(Shape)*(size_t)sc->num_shapes);
+    o_first  = off; off += align64(sizeof(size_t)*((size_t)sc->num_shapes+1));
+    o_pts    = off;
+    size_t fb = align64(sizeof(float)*sc->total);
+    off += (sc->layout == LAYOUT_SOA)? 4*fb : align64(sizeof(Point)*sc->total);
+    if (base){
+        sc->shapes = (Shape*)(base + o_shapes);
+        sc->first  = (size_t*)(base + o_first);
+        if (sc->layout == LAYOUT_SOA){
+            sc->soa.x  = (float*)(base + o_pts);
+            sc->soa.y  = (float*)(base + o_pts + fb);
+            sc->soa.vx = (float*)(base + o_pts + 2*fb);
+            sc->soa.vy = (float*)(base + o_pts + 3*fb);
+            sc->pool = NULL;
+        } else {
+            sc->pool = (Point*)(base + o_pts);
         }
-        int ci = rand() % PALETTE_SIZE;
-        shapes[s].color.r = PALETTE[ci][0];
-        shapes[s].color.g = PALETTE[ci][1];
-        shapes[s].color.b = PALETTE[ci][2];
-        shapes[s].color.a = 255;
     }
+    return off;
 }
 
-static void free_shapes(Shape* shapes, int num_shapes){
-    for (int s=0; s<num_shapes; s++){
-        free(shapes[s].points);
-        shapes[s].points = NULL;
+static void scene_alloc(Scene* sc){
+    sc->arena_bytes = scene_carve(sc, NULL);
+    sc->arena = arena_alloc(&sc->arena_bytes, sc->huge);
+    scene_carve(sc, (char*)sc->arena);
+}
+
+// Unidades de trabajo del update sobre el arreglo plano: una figura, o un bloque de
+// FLAT_BLOCK (AoS) / SOA_BLOCK (SoA) puntos con --loop point.
+static long scene_units(const Scene* sc, LoopKind loop){
+    const size_t blk = (sc->layout == LAYOUT_SOA)? SOA_BLOCK : FLAT_BLOCK;
+    return (loop == LOOP_POINT)? (long)((sc->total + blk - 1) / blk) : (long)sc->num_shapes;
+}
+
+static inline void scene_unit_range(const Scene* sc, LoopKind loop, long u, size_t* k0, size_t* k1){
+    if (loop == LOOP_POINT){
+        const size_t blk = (sc->layout == LAYOUT_SOA)? SOA_BLOCK : FLAT_BLOCK;
+        *k0 = (size_t)u*blk;
+        *k1 = (*k0 + blk < sc->total)? *k0 + blk : sc->total;
+    } else {
+        *k0 = sc->first[u];
+        *k1 = sc->first[u+1];
     }
 }
 
-// ---------- Update (seq / omp) ----------
-static inline void bounce(Point* p, int w, int h){
-    p->x += p->vx;
-    p->y += p->vy;
-    if (p->x < 0.f){ p->x = 0.f; p->vx = -p->vx; }
-    else if (p->x > (float)w){ p->x = (float)w; p->vx = -p->vx; }
-    if (p->y < 0.f){ p->y = 0.f; p->vy = -p->vy; }
-    else if (p->y > (float)h){ p->y = (float)h; p->vy = -p->vy; }
+// Primer toque de los puntos con el mismo reparto schedule(static) que usara el
+// update (por figura, o por bloques con --loop point): en maquinas NUMA cada pagina
+// queda en el nodo del hilo que la actualiza. src != NULL copia en vez de poner ceros.
+// Con --schedule dynamic/guided el reparto del update ya no es fijo.
+static void scene_touch_points(Scene* sc, const Scene* src, LoopKind loop){
+    const bool soa = (sc->layout == LAYOUT_SOA);
+    const long units = scene_units(sc, loop);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (long u=0; u<units; u++){
+        size_t k0, k1;
+        scene_unit_range(sc, loop, u, &k0, &k1);
+        size_t n = k1 - k0;
+        if (soa){
+            float* d[4] = { sc->soa.x, sc->soa.y, sc->soa.vx, sc->soa.vy };
+            for (int c=0; c<4; c++){
+                if (src){
+                    const float* f[4] = { src->soa.x, src->soa.y, src->soa.vx, src->soa.vy };
+                    memcpy(d[c] + k0, f[c] + k0, n*sizeof(float));
+                } else {
+                    memset(d[c] + k0, 0, n*sizeof(float));
+                }
+            }
+        } else if (src) memcpy(sc->pool + k0, src->pool + k0, n*sizeof(Point));
+        else            memset(sc->pool + k0, 0, n*sizeof(Point));
+    }
 }
 
-static void update_seq(Shape* shapes, int num_shapes, int pts, int w, int h){
-    for (int s=0; s<num_shapes; s++){
-        Point* P = shapes[s].points;
-        for (int i=0;i<pts;i++){
-            bounce(&P[i], w, h);
+// Valores de cada figura (puntos y color); mismo reparto static por figura que update_omp.
+static void scene_fill(Scene* sc, uint64_t key, int w, int h){
+    Shape* shapes = sc->shapes;
+    const bool soa = (sc->layout == LAYOUT_SOA);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int s=0; s<sc->num_shapes; s++){
+        const size_t f = sc->first[s];
+        shapes[s].points = soa? NULL : sc->pool + f;
+        for (int i=0;i<shapes[s].n;i++){
+            Point p = rand_point(key, s, i, w, h);
+            if (soa){
+                size_t k = f + i;
+                sc->soa.x[k] = p.x; sc->soa.y[k] = p.y; sc->soa.vx[k] = p.vx; sc->soa.vy[k] = p.vy;
+            } else {
+                shapes[s].points[i] = p;
+            }
         }
+        rand_color(&shapes[s], key, s);
     }
 }
 
-static void update_omp(Shape* shapes, int num_shapes, int pts, int w, int h){
+static void scene_init(Scene* sc, const Args* a){
+    uint64_t key = mix64(a->seed);
+    memset(sc, 0, sizeof(*sc));
+    sc->layout = a->layout;
+    sc->num_shapes = a->num_shapes;
+    sc->huge = a->hugepages;
+    if (a->dist == DIST_ZIPF) zipf_table(a->zipf_s, a->points_per_shape);
+
+    // 1) total de puntos (rand_npoints es puro: se vuelve a evaluar al llenar)
+    size_t total = 0;
+    int max_pts = 0;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) reduction(+:total) reduction(max:max_pts)
+#endif
+    for (int s=0; s<sc->num_shapes; s++){
+        int n = rand_npoints(a, key, s);
+        total += (size_t)n;
+        if (n > max_pts) max_pts = n;
+    }
+    sc->total = total;
+    sc->max_pts = max_pts;
+    scene_alloc(sc);
+
+    // 2) Shape[] y first[] tocados por figura, como los lee el update
+    Shape* shapes = sc->shapes;
 #ifdef _OPENMP
-    // Dos opciones: paralelizar por figura o por punto. Aquí por figura:
     #pragma omp parallel for schedule(static)
-    for (int s=0; s<num_shapes; s++){
-        Point* P = shapes[s].points;
-        for (int i=0;i<pts;i++){
-            bounce(&P[i], w, h);
-        }
+#endif
+    for (int s=0; s<sc->num_shapes; s++){
+        memset(&shapes[s], 0, sizeof(Shape));
+        shapes[s].n = rand_npoints(a, key, s);
+        sc->first[s] = 0;
     }
+    sc->first[0] = 0;
+    for (int s=0; s<sc->num_shapes; s++) sc->first[s+1] = sc->first[s] + (size_t)shapes[s].n;
+
+    // 3) puntos: con --loop point el reparto del update es por bloques, no por figura
+    if (a->mode == MODE_OMP && a->loop == LOOP_POINT) scene_touch_points(sc, NULL, a->loop);
+    scene_fill(sc, key, a->winW, a->winH);
+}
+
+static void scene_free(Scene* sc){
+    if (sc->map){
+#ifdef HAVE_SHM
+        munmap(sc->map, sc->map_bytes);
 #else
-    // Fallback si no hay OpenMP
-    update_seq(shapes, num_shapes, pts, w, h);
+        aligned_free64(sc->map);
 #endif
+    } else if (sc->arena) aligned_free64(sc->arena);
+    memset(sc, 0, sizeof(*sc));
 }
 
-// ---------- Render ----------
-static void render(SDL_Renderer* R, Shape* shapes, int num_shapes, int pts){
-    // Fondo oscuro
-    SDL_SetRenderDrawColor(R, 3,3,6,255);
-    SDL_RenderClear(R);
+// Copia profunda (mismo layout y tamaños); usada como buffer trasero del pipeline.
+// La copia tambien hace el primer toque con el reparto del update.
+static void scene_clone(Scene* dst, const Scene* src, LoopKind loop){
+    *dst = *src;
+    dst->map = NULL;
+    scene_alloc(dst);
+    const int S = src->num_shapes;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int s=0; s<S; s++){
+        dst->shapes[s] = src->shapes[s];
+        dst->first[s] = src->first[s];
+        if (dst->pool) dst->shapes[s].points = dst->pool + src->first[s];
+    }
+    dst->first[S] = src->first[S];
+    scene_touch_points(dst, src, loop);
+}
 
-    for (int s=0; s<num_shapes; s++){
-        SDL_SetRenderDrawColor(R, shapes[s].color.r, shapes[s].color.g, shapes[s].color.b, 255);
-        for (int i=0;i<pts;i++){
-            int j = (i+1)%pts;
-            SDL_RenderDrawLine(R,
-                (int)shapes[s].points[i].x, (int)shapes[s].points[i].y,
-                (int)shapes[s].points[j].x, (int)shapes[s].points[j].y
-            );
+// Checksum del estado (posiciones y velocidades, bit a bit), igual para AoS y SoA.
+// Hash por figura sumado mod 2^64: no depende del orden ni del numero de hilos.
+static uint64_t scene_checksum(const Scene* sc){
+    uint64_t sum = 0;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) reduction(+:sum)
+#endif
+    for (int s=0; s<sc->num_shapes; s++){
+        uint64_t h = mix64((uint64_t)s);
+        for (int i=0;i<sc->shapes[s].n;i++){
+            Point p;
+            if (sc->layout == LAYOUT_SOA){
+                size_t k = sc->first[s] + i;
+                p.x = sc->soa.x[k]; p.y = sc->soa.y[k]; p.vx = sc->soa.vx[k]; p.vy = sc->soa.vy[k];
+            } else {
+                p = sc->shapes[s].points[i];
+            }
+            uint32_t b[4];
+            memcpy(b, &p, sizeof(b));
+            h = mix64(h ^ (((uint64_t)b[0] << 32) | b[1]));
+            h = mix64(h ^ (((uint64_t)b[2] << 32) | b[3]));
         }
+        sum += h;
     }
-    SDL_RenderPresent(R);
+    return sum;
 }
 
-// ---------- Loop principal ----------
-static double now_ms(void){
-    return (double)SDL_GetTicks();
+// Posicion del punto i de la figura s, sin importar el layout.
+static inline void scene_point(const Scene* sc, int s, int i, float* x, float* y){
+    if (sc->layout == LAYOUT_SOA){
+        size_t k = sc->first[s] + i;
+        *x = sc->soa.x[k]; *y = sc->soa.y[k];
+    } else {
+        *x = sc->shapes[s].points[i].x; *y = sc->shapes[s].points[i].y;
+    }
 }
 
-static double run_once(SDL_Window* W, SDL_Renderer* R, const Args* a){
-    // Corre por a->secs (si >0) o hasta cerrar.
-    const int target_ms_per_frame = 16; // ~60 fps
-    Uint32 start_ms = SDL_GetTicks();
-    Uint32 end_ms = (a->secs>0)? (start_ms + (Uint32)a->secs*1000u) : UINT32_MAX;
+// ---------- Trazas (--trace) ----------
+// Cada hilo (numero de hilo OpenMP; 0 = el principal) escribe sus eventos en su propio
+// anillo de TRACE_RING entradas, sin atomicos ni locks; al salir se vuelcan como JSON
+// trace_event de Chrome (chrome://tracing, Perfetto). Sin --trace cada punto de
+// medicion cuesta una lectura de g_trace.on y un salto predecible.
+// --trace-counters agrega ciclos, instrucciones y fallos de LLC por evento con un
+// grupo perf_event_open por hilo (Linux), abierto la primera vez que el hilo traza.
+#define TRACE_RING (1 << 15)   // potencia de 2; se guardan los ultimos eventos
+#define TRACE_NCTR 3
 
-    Shape* shapes = (Shape*)calloc(a->num_shapes, sizeof(Shape));
-    if (!shapes){ fprintf(stderr,"[ERR] sin memoria (shapes)\n"); exit(3); }
-    init_shapes(shapes, a->num_shapes, a->points_per_shape, a->winW, a->winH);
+typedef enum { TR_EVENTS=0, TR_UPDATE, TR_BARRIER, TR_RENDER, TR_PRESENT, TR_COLLIDE,
+               TR_PUBLISH, TR_RASTER, TR_UPLOAD, TR_FILL, TR_NPHASES } TracePhase;
+static const char* const TRACE_NAMES[TR_NPHASES] = {
+    "events", "update", "barrier", "render", "present", "collide", "publish", "raster", "upload", "fill"
+};
 
-    bool running = true;
-    SDL_Event e;
-    int frames = 0;
-    double fps_timer = now_ms(), fps_acc_secs = 0.0;
-    int fps_count = 0;
-    double total_ms = 0.0;
+typedef struct {
+    uint64_t t0, t1;             // SDL_GetPerformanceCounter
+    uint32_t phase, arg;         // arg: iteraciones del hilo en update
+    uint64_t ctr[TRACE_NCTR];    // deltas de contadores (solo con --trace-counters)
+} TraceEvent;
 
-    while (running){
-        // Eventos
-        while (SDL_PollEvent(&e)){
-            if (e.type==SDL_QUIT) running=false;
-            if (e.type==SDL_KEYDOWN || e.type==SDL_MOUSEBUTTONDOWN) running=false;
-        }
-        if (SDL_GetTicks() >= end_ms) running=false;
+// Quien escribio en un anillo (nombre del hilo en el JSON): OpenMP o el pool.
+#define TRACE_BY_OMP  1u
+#define TRACE_BY_POOL 2u
 
-        double t0 = now_ms();
-        // Update
-        if (a->mode == MODE_SEQ) update_seq(shapes, a->num_shapes, a->points_per_shape, a->winW, a->winH);
-        else                     update_omp(shapes, a->num_shapes, a->points_per_shape, a->winW, a->winH);
+typedef struct {
+    TraceEvent* ev;
+    uint64_t n;                  // eventos escritos en total
+    uint32_t by;                 // TRACE_BY_*
+    char pad[44];                // un anillo por linea de cache
+} TraceRing;
 
-        // Render (main thread)
-        render(R, shapes, a->num_shapes, a->points_per_shape);
+// Hilos que no son de OpenMP (pool de --mode pool) fijan aqui su numero de anillo.
+static _Thread_local int tls_trace_tid = -1;
 
-        double t1 = now_ms();
-        double dt = t1 - t0;
-        total_ms += dt;
-        frames++;
+static struct {
+    bool on, counters;
+    int nthreads;
+    TraceRing* ring;
+    const char* path;
+} g_trace;
+
+#ifdef __linux__
+static _Thread_local int tls_perf_fd = -2;   // -2 = sin abrir, -1 = no disponible
+static _Thread_local uint64_t tls_ctr[TRACE_NCTR];
 
-        // Limitar a ~60 FPS de manera simple (opcional)
-        if (dt < target_ms_per_frame){
-            SDL_Delay((Uint32)(target_ms_per_frame - dt));
+// Grupo ciclos + instrucciones + fallos de LLC del hilo que llama, en espacio de usuario.
+static int perf_open_group(void){
+    static const uint64_t cfg[TRACE_NCTR] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    int fds[TRACE_NCTR];
+    for (int k=0; k<TRACE_NCTR; k++){
+        struct perf_event_attr pa;
+        memset(&pa, 0, sizeof(pa));
+        pa.size = sizeof(pa);
+        pa.type = PERF_TYPE_HARDWARE;
+        pa.config = cfg[k];
+        pa.disabled = (k == 0);
+        pa.exclude_kernel = 1;
+        pa.exclude_hv = 1;
+        pa.read_format = PERF_FORMAT_GROUP;
+        fds[k] = (int)syscall(SYS_perf_event_open, &pa, 0, -1, k? fds[0] : -1, 0);
+        if (fds[k] < 0){
+            while (k-- > 0) close(fds[k]);
+            return -1;
         }
+    }
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return fds[0];
+}
 
-        // FPS cada ~500 ms en el título
-        double now = now_ms();
-        double elapsed = (now - fps_timer);
-        fps_acc_secs += elapsed / 1000.0;
-        fps_timer = now;
-        fps_count++;
+static void perf_read(uint64_t out[TRACE_NCTR]){
+    if (tls_perf_fd == -2) tls_perf_fd = perf_open_group();
+    uint64_t buf[1 + TRACE_NCTR];
+    if (tls_perf_fd < 0 || read(tls_perf_fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)){
+        memset(out, 0, sizeof(uint64_t)*TRACE_NCTR);
+        return;
+    }
+    memcpy(out, buf + 1, sizeof(uint64_t)*TRACE_NCTR);   // buf[0] = cantidad de contadores
+}
+#endif
 
-        if (fps_acc_secs >= 0.5){
-            double fps = (double)frames / ((double)(now - (double)start_ms) / 1000.0);
-            char title[128];
-            snprintf(title, sizeof(title),
-                "Mystify | %s | %d shapes x %d pts | FPS: %.1f",
-                (a->mode==MODE_SEQ? "SEQ":"OMP"), a->num_shapes, a->points_per_shape, fps);
-            SDL_SetWindowTitle(W, title);
-            fps_acc_secs = 0.0;
-            fps_count = 0;
+static void trace_init(const Args* a){
+    g_trace.path = a->trace_path;
+    g_trace.nthreads = omp_get_max_threads();
+    for (int k=0; k<a->n_threads; k++)
+        if (a->threads_list[k] > g_trace.nthreads) g_trace.nthreads = a->threads_list[k];
+    if (a->mode == MODE_POOL && SDL_GetCPUCount() > g_trace.nthreads) g_trace.nthreads = SDL_GetCPUCount();
+    g_trace.ring = (TraceRing*)aligned_alloc64(sizeof(TraceRing)*g_trace.nthreads);
+    for (int t=0; t<g_trace.nthreads; t++){
+        g_trace.ring[t].ev = (TraceEvent*)aligned_alloc64(sizeof(TraceEvent)*TRACE_RING);
+        g_trace.ring[t].n = 0;
+        g_trace.ring[t].by = 0;
+    }
+    g_trace.counters = a->trace_counters;
+#ifdef __linux__
+    if (g_trace.counters){
+        uint64_t probe[TRACE_NCTR];
+        perf_read(probe);
+        if (tls_perf_fd < 0){
+            fprintf(stderr,"[WARN] perf_event_open no disponible (ver /proc/sys/kernel/perf_event_paranoid); "
+                           "trazas sin contadores.\n");
+            g_trace.counters = false;
         }
     }
+#endif
+    g_trace.on = true;
+}
 
-    free_shapes(shapes, a->num_shapes);
-    free(shapes);
+// Marca de inicio: 0 si las trazas estan apagadas.
+static inline uint64_t trace_begin(void){
+    if (!g_trace.on) return 0;
+#ifdef __linux__
+    if (g_trace.counters) perf_read(tls_ctr);
+#endif
+    return SDL_GetPerformanceCounter();
+}
 
-    double avg_ms = (frames>0)? (total_ms/frames) : 0.0;
-    return avg_ms; // devuelve ms por frame promedio (del trabajo lógico y render)
+// Registra [t0, ahora) en el anillo del hilo y devuelve ahora, que sirve de inicio
+// del evento siguiente (p. ej. update -> barrier) con sus contadores.
+static inline uint64_t trace_end(TracePhase ph, uint64_t t0, uint32_t arg){
+    if (!g_trace.on) return 0;
+    uint64_t t1 = SDL_GetPerformanceCounter();
+    int tid = (tls_trace_tid >= 0)? tls_trace_tid : omp_get_thread_num();
+    if (tid >= g_trace.nthreads) return t1;
+    TraceRing* r = &g_trace.ring[tid];
+    r->by |= (tls_trace_tid >= 0)? TRACE_BY_POOL : TRACE_BY_OMP;
+    TraceEvent* e = &r->ev[r->n++ & (TRACE_RING-1)];
+    e->t0 = t0; e->t1 = t1; e->phase = (uint32_t)ph; e->arg = arg;
+#ifdef __linux__
+    if (g_trace.counters){
+        uint64_t now[TRACE_NCTR];
+        perf_read(now);
+        for (int k=0; k<TRACE_NCTR; k++){ e->ctr[k] = now[k] - tls_ctr[k]; tls_ctr[k] = now[k]; }
+    }
+#endif
+    return t1;
 }
 
-// ---------- Benchmark ----------
-static void write_csv_header(FILE* f){
-    fprintf(f, "mode,threads,shapes,points,width,height,secs,avg_ms_per_frame,fps,speedup,efficiency\n");
+// Escribe el JSON y un resumen por fase; libera los anillos.
+static void trace_dump(void){
+    if (!g_trace.on) return;
+    g_trace.on = false;
+    FILE* f = fopen(g_trace.path, "w");
+    if (!f){ fprintf(stderr,"[ERR] no se pudo crear %s\n", g_trace.path); return; }
+    const double us = 1e6 / (double)SDL_GetPerformanceFrequency();
+    uint64_t base = UINT64_MAX;
+    for (int t=0; t<g_trace.nthreads; t++){
+        const TraceRing* r = &g_trace.ring[t];
+        uint64_t k0 = (r->n > TRACE_RING)? r->n - TRACE_RING : 0;
+        if (r->n > k0 && r->ev[k0 & (TRACE_RING-1)].t0 < base) base = r->ev[k0 & (TRACE_RING-1)].t0;
+    }
+    double sum_ms[TR_NPHASES] = {0};
+    uint64_t cnt[TR_NPHASES] = {0}, ctr[TR_NPHASES][TRACE_NCTR];
+    memset(ctr, 0, sizeof(ctr));
+    long dropped = 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (int t=0; t<g_trace.nthreads; t++){
+        const TraceRing* r = &g_trace.ring[t];
+        if (r->n == 0) continue;
+        // El 0 es el hilo principal con cualquier backend; el resto, segun quien escribio
+        // (en --bench un mismo anillo puede tener eventos de OpenMP y del pool)
+        const char* who = (t == 0)? "main" : (r->by == TRACE_BY_POOL)? "pool" :
+                          (r->by == TRACE_BY_OMP)? "omp" : "omp/pool";
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                first? "" : ",\n", t, who, t);
+        first = false;
+        uint64_t k0 = (r->n > TRACE_RING)? r->n - TRACE_RING : 0;
+        dropped += (long)k0;
+        for (uint64_t k=k0; k<r->n; k++){
+            const TraceEvent* e = &r->ev[k & (TRACE_RING-1)];
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                       "\"args\":{\"n\":%u", TRACE_NAMES[e->phase], t,
+                    (double)(e->t0 - base)*us, (double)(e->t1 - e->t0)*us, e->arg);
+            if (g_trace.counters)
+                fprintf(f, ",\"cycles\":%llu,\"instructions\":%llu,\"llc_misses\":%llu",
+                        (unsigned long long)e->ctr[0], (unsigned long long)e->ctr[1], (unsigned long long)e->ctr[2]);
+            fprintf(f, "}}");
+            sum_ms[e->phase] += (double)(e->t1 - e->t0)*us/1000.0;
+            cnt[e->phase]++;
+            // sin --trace-counters e->ctr no se escribe (el anillo no se limpia)
+            if (g_trace.counters) for (int c=0; c<TRACE_NCTR; c++) ctr[e->phase][c] += e->ctr[c];
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    printf("[TRACE] %s | %d hilos%s\n", g_trace.path, g_trace.nthreads,
+           dropped? " | anillos llenos: solo los ultimos eventos" : "");
+    for (int p=0; p<TR_NPHASES; p++){
+        if (!cnt[p]) continue;
+        printf("[TRACE] %-8s %8llu eventos | %10.3f ms en total | %.4f ms/evento",
+               TRACE_NAMES[p], (unsigned long long)cnt[p], sum_ms[p], sum_ms[p]/(double)cnt[p]);
+        if (g_trace.counters && ctr[p][0])
+            printf(" | IPC %.2f | %.1f fallos LLC/evento", (double)ctr[p][1]/(double)ctr[p][0],
+                   (double)ctr[p][2]/(double)cnt[p]);
+        printf("\n");
+    }
+    for (int t=0; t<g_trace.nthreads; t++) aligned_free64(g_trace.ring[t].ev);
+    aligned_free64(g_trace.ring);
+    g_trace.ring = NULL;
 }
 
-static void bench_all(SDL_Window* W, SDL_Renderer* R, Args a){
-    // Prepara CSV
-    FILE* f = fopen("bench.csv","w");
-    if (!f){ fprintf(stderr,"[ERR] no se pudo crear bench.csv\n"); return; }
-    write_csv_header(f);
+// ---------- Update (seq / omp) ----------
+static inline void bounce(Point* p, int w, int h){
+    p->x += p->vx;
+    p->y += p->vy;
+    if (p->x < 0.f){ p->x = 0.f; p->vx = -p->vx; }
+    else if (p->x > (float)w){ p->x = (float)w; p->vx = -p->vx; }
+    if (p->y < 0.f){ p->y = 0.f; p->vy = -p->vy; }
+    else if (p->y > (float)h){ p->y = (float)h; p->vy = -p->vy; }
+}
 
-    // Medimos secuencial primero como base
-    a.mode = MODE_SEQ;
-    a.secs = (a.secs>0? a.secs: 8); // por si no pusieron --secs
-    printf("[BENCH] SEQ ...\n");
-    double ms_seq = run_once(W,R,&a);
-    double fps_seq = (ms_seq>0.0)? (1000.0/ms_seq) : 0.0;
-    fprintf(f, "seq,%d,%d,%d,%d,%d,%d,%.6f,%.3f,%.3f,%.3f\n",
-            1, a.num_shapes, a.points_per_shape, a.winW, a.winH, a.secs,
-            ms_seq, fps_seq, 1.0, 1.0);
+static void update_seq(Shape* shapes, int num_shapes, int w, int h){
+    for (int s=0; s<num_shapes; s++){
+        Point* P = shapes[s].points;
+        for (int i=0;i<shapes[s].n;i++){
+            bounce(&P[i], w, h);
+        }
+    }
+}
 
+// El schedule lo fija apply_schedule() (--schedule) via schedule(runtime).
+// Los loops omp del update separan el for (nowait) de la barrera para que --trace
+// registre por hilo el tiempo de trabajo y el de espera en la barrera.
+static void update_omp(Shape* shapes, int num_shapes, int w, int h){
 #ifdef _OPENMP
-    int maxT = omp_get_max_threads();
-    // probamos potencias de 2 hasta maxT
-    for (int T=1; T<=maxT; T<<=1){
-        printf("[BENCH] OMP threads=%d ...\n", T);
-        // Fijar num threads para esta corrida
-        omp_set_num_threads(T);
-        Args b = a; b.mode = MODE_OMP;
-        double ms_par = run_once(W,R,&b);
-        double fps_par = (ms_par>0.0)? (1000.0/ms_par) : 0.0;
-        double speedup = (ms_par>0.0)? (ms_seq/ms_par) : 0.0;
-        double eff = (T>0)? (speedup/(double)T) : 0.0;
-
-        fprintf(f, "omp,%d,%d,%d,%d,%d,%d,%.6f,%.3f,%.3f,%.3f\n",
-                T, b.num_shapes, b.points_per_shape, b.winW, b.winH, b.secs,
-                ms_par, fps_par, speedup, eff);
+    // Dos opciones: paralelizar por figura o por punto. Aquí por figura:
+    #pragma omp parallel
+    {
+        uint64_t tw = trace_begin();
+        uint32_t it = 0;
+        #pragma omp for schedule(runtime) nowait
+        for (int s=0; s<num_shapes; s++){
+            Point* P = shapes[s].points;
+            for (int i=0;i<shapes[s].n;i++){
+                bounce(&P[i], w, h);
+            }
+            it++;
+        }
+        uint64_t tb = trace_end(TR_UPDATE, tw, it);
+        #pragma omp barrier
+        trace_end(TR_BARRIER, tb, 0);
     }
 #else
-    printf("[BENCH] OpenMP no disponible; solo SEQ registrado.\n");
+    // Fallback si no hay OpenMP
+    update_seq(shapes, num_shapes, w, h);
 #endif
+}
 
-    fclose(f);
-    printf("[BENCH] Listo: bench.csv\n");
+#ifdef _OPENMP
+// Figura que contiene el punto plano k (busqueda binaria en first).
+static int shape_of_point(const size_t* first, int num_shapes, size_t k){
+    int lo = 0, hi = num_shapes-1;
+    while (lo < hi){
+        int mid = lo + (hi-lo+1)/2;
+        if (first[mid] <= k) lo = mid; else hi = mid-1;
+    }
+    return lo;
 }
+#endif
 
-// ---------- Main ----------
-int main(int argc, char** argv){
-    srand((unsigned)time(NULL));
+// Loop aplanado sobre todos los puntos en bloques de FLAT_BLOCK: el reparto queda
+// balanceado por puntos aunque las figuras tengan tamaños muy distintos.
+static void update_omp_points(Shape* shapes, const size_t* first, int num_shapes, size_t total, int w, int h){
+#ifdef _OPENMP
+    long nblocks = (long)((total + FLAT_BLOCK - 1) / FLAT_BLOCK);
+    #pragma omp parallel
+    {
+        uint64_t tw = trace_begin();
+        uint32_t it = 0;
+        #pragma omp for schedule(runtime) nowait
+        for (long b=0; b<nblocks; b++){
+            size_t k = (size_t)b * FLAT_BLOCK;
+            size_t k1 = (k + FLAT_BLOCK < total)? k + FLAT_BLOCK : total;
+            int s = shape_of_point(first, num_shapes, k);
+            while (k < k1){
+                size_t e = (first[s+1] < k1)? first[s+1] : k1;
+                Point* P = shapes[s].points;
+                for (size_t q=k; q<e; q++) bounce(&P[q - first[s]], w, h);
+                k = e;
+                s++;
+            }
+            it++;
+        }
+        uint64_t tb = trace_end(TR_UPDATE, tw, it);
+        #pragma omp barrier
+        trace_end(TR_BARRIER, tb, 0);
+    }
+#else
+    (void)first; (void)total;
+    update_seq(shapes, num_shapes, w, h);
+#endif
+}
 
-    Args args;
-    parse_args(argc, argv, &args);
+// --schedule -> schedule(runtime) de los loops de update.
+static void apply_schedule(const Args* a){
+#ifdef _OPENMP
+    omp_sched_t k = (a->sched == SCHED_DYNAMIC)? omp_sched_dynamic
+                  : (a->sched == SCHED_GUIDED)?  omp_sched_guided : omp_sched_static;
+    omp_set_schedule(k, a->sched_chunk);
+#else
+    (void)a;
+#endif
+}
 
-    if (SDL_Init(SDL_INIT_VIDEO) != 0){
-        fprintf(stderr,"[ERR] SDL_Init: %s\n", SDL_GetError()); return 1;
+// ---------- Update SoA (kernel sin ramas) ----------
+// Mismo resultado que bounce(): clamp al borde e invertir la velocidad si hubo
+// contacto. Sin ramas para que el compilador lo vectorice (SSE/AVX segun -march).
+// Lee de in y escribe en out (pueden ser el mismo: cada k solo toca su indice).
+static inline void bounce_soa(const PointsSoA* in, PointsSoA* out,
+                              size_t k0, size_t n, float w, float h){
+    const float* ix = in->x + k0;  const float* iy = in->y + k0;
+    const float* ivx = in->vx + k0; const float* ivy = in->vy + k0;
+    float* x = out->x + k0;  float* y = out->y + k0;
+    float* vx = out->vx + k0; float* vy = out->vy + k0;
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (size_t k=0; k<n; k++){
+        float nx = ix[k] + ivx[k];
+        float ny = iy[k] + ivy[k];
+        float cx = nx < 0.f ? 0.f : nx;
+        float cy = ny < 0.f ? 0.f : ny;
+        cx = cx > w ? w : cx;
+        cy = cy > h ? h : cy;
+        float sx = (cx != nx) ? -1.f : 1.f;
+        float sy = (cy != ny) ? -1.f : 1.f;
+        vx[k] = ivx[k] * sx;
+        vy[k] = ivy[k] * sy;
+        x[k] = cx;
+        y[k] = cy;
     }
+}
 
-    SDL_Window* window = SDL_CreateWindow(
-        "Mystify", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        args.winW, args.winH, SDL_WINDOW_SHOWN
-    );
-    if (!window){ fprintf(stderr,"[ERR] SDL_CreateWindow: %s\n", SDL_GetError()); SDL_Quit(); return 1; }
+static void update_soa_seq(PointsSoA* P, size_t n, int w, int h){
+    bounce_soa(P, P, 0, n, (float)w, (float)h);
+}
 
-    // SDL_RENDERER_PRESENTVSYNC no es obligatorio; usamos acelerado.
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    if (!renderer){ fprintf(stderr,"[ERR] SDL_CreateRenderer: %s\n", SDL_GetError()); SDL_DestroyWindow(window); SDL_Quit(); return 1; }
+static void update_soa_omp(PointsSoA* P, size_t n, int w, int h){
+#ifdef _OPENMP
+    long nblocks = (long)((n + SOA_BLOCK - 1) / SOA_BLOCK);
+    #pragma omp parallel
+    {
+        uint64_t tw = trace_begin();
+        uint32_t it = 0;
+        #pragma omp for schedule(runtime) nowait
+        for (long b=0; b<nblocks; b++){
+            size_t k0 = (size_t)b * SOA_BLOCK;
+            size_t len = (n - k0 < SOA_BLOCK)? (n - k0) : SOA_BLOCK;
+            bounce_soa(P, P, k0, len, (float)w, (float)h);
+            it++;
+        }
+        uint64_t tb = trace_end(TR_UPDATE, tw, it);
+        #pragma omp barrier
+        trace_end(TR_BARRIER, tb, 0);
+    }
+#else
+    update_soa_seq(P, n, w, h);
+#endif
+}
+
+// SoA por figura: cada iteracion es el rango contiguo de una figura.
+static void update_soa_omp_shapes(PointsSoA* P, const size_t* first, int num_shapes, int w, int h){
+#ifdef _OPENMP
+    #pragma omp parallel
+    {
+        uint64_t tw = trace_begin();
+        uint32_t it = 0;
+        #pragma omp for schedule(runtime) nowait
+        for (int s=0; s<num_shapes; s++){
+            bounce_soa(P, P, first[s], first[s+1]-first[s], (float)w, (float)h);
+            it++;
+        }
+        uint64_t tb = trace_end(TR_UPDATE, tw, it);
+        #pragma omp barrier
+        trace_end(TR_BARRIER, tb, 0);
+    }
+#else
+    update_soa_seq(P, first[num_shapes], w, h);
+#endif
+}
+
+// ---------- Pool de hilos persistente (--mode pool) ----------
+// Alternativa a los parallel for de OpenMP para el update: nw hilos (el principal es
+// el 0) que se crean una vez por corrida, no uno por figura. Cada frame es una epoca:
+// las unidades del update (figuras o bloques, como scene_units) se reparten en nw
+// rangos contiguos, uno por deque. El dueño toma TPOOL_GRAIN unidades del frente de
+// su rango y un hilo sin trabajo roba la mitad trasera del rango de otro y la pone en
+// su deque (se puede volver a robar). Cada deque es un par (lo, hi) de 32 bits en una
+// palabra atomica de 64: tomar y robar son un CAS, sin locks. El principal espera a
+// los demas al final de la epoca (barrera) y los hilos esperan la epoca siguiente
+// girando TPOOL_SPIN vueltas y despues dormidos, para no competir con las regiones
+// OpenMP del resto del frame. Hilos de SDL (pthreads en POSIX), como --export.
+#define TPOOL_GRAIN 16       // unidades por toma del dueño
+#define TPOOL_SPIN  20000    // vueltas antes de dormir esperando la epoca siguiente
+
+typedef void (*TPoolFn)(void* ctx, long u0, long u1);
+
+typedef struct {
+    _Atomic uint64_t range;  // lo | hi << 32: unidades [lo, hi) sin tomar
+    char pad[56];            // un deque por linea de cache
+} TPoolDeque;
+
+typedef struct ThreadPool ThreadPool;
+typedef struct { ThreadPool* p; int id; } TPoolWorker;
+
+struct ThreadPool {
+    int nw;
+    SDL_Thread** th;
+    TPoolWorker* wk;
+    TPoolDeque* dq;
+    _Atomic uint64_t epoch;
+    _Atomic long left;       // unidades sin terminar en la epoca
+    _Atomic int done;        // hilos (sin el principal) que terminaron la epoca
+    _Atomic bool quit;
+    SDL_mutex* lock;
+    SDL_cond* wake;
+    TPoolFn fn;              // trabajo de la epoca: se escribe antes de publicar epoch
+    void* ctx;
+    _Atomic long steals;
+    long epochs;
+};
+
+static ThreadPool g_tpool;   // activo solo con --mode pool (nw == 0 si no)
+
+static inline void tpool_relax(void){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Espera activa; tras TPOOL_SPIN vueltas cede el nucleo (si hay mas hilos que
+// nucleos, el hilo esperado puede no estar corriendo).
+static inline void tpool_wait(int* spin){
+    if (++*spin < TPOOL_SPIN) tpool_relax();
+    else SDL_Delay(0);
+}
+
+static inline uint64_t tpool_pack(long lo, long hi){ return (uint64_t)lo | ((uint64_t)hi << 32); }
+
+// Dueño: hasta TPOOL_GRAIN unidades del frente.
+static bool tpool_pop(TPoolDeque* d, long* u0, long* u1){
+    uint64_t r = atomic_load_explicit(&d->range, memory_order_acquire);
+    for (;;){
+        long lo = (long)(uint32_t)r, hi = (long)(r >> 32);
+        if (lo >= hi) return false;
+        long nlo = (hi - lo > TPOOL_GRAIN)? lo + TPOOL_GRAIN : hi;
+        if (atomic_compare_exchange_weak_explicit(&d->range, &r, tpool_pack(nlo, hi),
+                                                  memory_order_acq_rel, memory_order_acquire)){
+            *u0 = lo; *u1 = nlo;
+            return true;
+        }
+    }
+}
+
+// Ladron: la mitad trasera (al menos una unidad).
+static bool tpool_steal(TPoolDeque* d, long* u0, long* u1){
+    uint64_t r = atomic_load_explicit(&d->range, memory_order_acquire);
+    for (;;){
+        long lo = (long)(uint32_t)r, hi = (long)(r >> 32);
+        if (lo >= hi) return false;
+        long mid = hi - (hi - lo + 1)/2;
+        if (atomic_compare_exchange_weak_explicit(&d->range, &r, tpool_pack(lo, mid),
+                                                  memory_order_acq_rel, memory_order_acquire)){
+            *u0 = mid; *u1 = hi;
+            return true;
+        }
+    }
+}
+
+// Trabajo de un hilo en la epoca: su deque y despues robos hasta que no quede nada.
+// Devuelve el fin del evento update (inicio de la espera en la barrera).
+static uint64_t tpool_work(ThreadPool* p, int id){
+    uint64_t tw = trace_begin();
+    uint32_t it = 0;
+    int idle = 0;
+    long u0, u1;
+    for (;;){
+        if (tpool_pop(&p->dq[id], &u0, &u1)){
+            p->fn(p->ctx, u0, u1);
+            it += (uint32_t)(u1 - u0);
+            atomic_fetch_sub_explicit(&p->left, u1 - u0, memory_order_acq_rel);
+            continue;
+        }
+        if (atomic_load_explicit(&p->left, memory_order_acquire) == 0) break;
+        bool got = false;
+        for (int k=1; k<p->nw && !got; k++){
+            // Solo este hilo escribe su deque cuando esta vacio: los demas no le pueden robar
+            if (tpool_steal(&p->dq[(id + k) % p->nw], &u0, &u1)){
+                atomic_store_explicit(&p->dq[id].range, tpool_pack(u0, u1), memory_order_release);
+                atomic_fetch_add_explicit(&p->steals, 1, memory_order_relaxed);
+                got = true;
+            }
+        }
+        if (!got) tpool_wait(&idle);
+    }
+    return trace_end(TR_UPDATE, tw, it);
+}
+
+static int tpool_thread(void* arg){
+    TPoolWorker* w = (TPoolWorker*)arg;
+    ThreadPool* p = w->p;
+    tls_trace_tid = w->id;
+    uint64_t seen = 0;
+    for (;;){
+        uint64_t e;
+        int spin = 0;
+        while ((e = atomic_load_explicit(&p->epoch, memory_order_acquire)) == seen &&
+               !atomic_load_explicit(&p->quit, memory_order_acquire)){
+            if (++spin < TPOOL_SPIN){ tpool_relax(); continue; }
+            SDL_LockMutex(p->lock);
+            while (atomic_load(&p->epoch) == seen && !atomic_load(&p->quit))
+                SDL_CondWait(p->wake, p->lock);
+            SDL_UnlockMutex(p->lock);
+        }
+        if (atomic_load_explicit(&p->quit, memory_order_acquire)) return 0;
+        seen = e;
+        tpool_work(p, w->id);
+        atomic_fetch_add_explicit(&p->done, 1, memory_order_release);
+    }
+}
+
+// Hilos del pool: los de OpenMP si hay (OMP_NUM_THREADS, --threads del benchmark),
+// si no los nucleos que reporta SDL.
+static int tpool_nthreads(void){
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    int n = SDL_GetCPUCount();
+    return n > 0? n : 1;
+#endif
+}
+
+static void tpool_start(ThreadPool* p, int nw){
+    memset(p, 0, sizeof(*p));
+    p->nw = nw;
+    p->dq = (TPoolDeque*)aligned_alloc64(sizeof(TPoolDeque)*(size_t)nw);
+    p->th = (SDL_Thread**)calloc((size_t)nw, sizeof(SDL_Thread*));
+    p->wk = (TPoolWorker*)calloc((size_t)nw, sizeof(TPoolWorker));
+    if (!p->th || !p->wk){ fprintf(stderr,"[ERR] sin memoria (pool)\n"); exit(3); }
+    for (int w=0; w<nw; w++) atomic_init(&p->dq[w].range, 0);
+    atomic_init(&p->epoch, 0);
+    atomic_init(&p->left, 0);
+    atomic_init(&p->done, 0);
+    atomic_init(&p->quit, false);
+    atomic_init(&p->steals, 0);
+    p->lock = SDL_CreateMutex();
+    p->wake = SDL_CreateCond();
+    if (!p->lock || !p->wake){ fprintf(stderr,"[ERR] SDL_CreateMutex/Cond: %s\n", SDL_GetError()); exit(1); }
+    for (int w=1; w<nw; w++){
+        p->wk[w].p = p;
+        p->wk[w].id = w;
+        p->th[w] = SDL_CreateThread(tpool_thread, "mystify-pool", &p->wk[w]);
+        if (!p->th[w]){ fprintf(stderr,"[ERR] SDL_CreateThread: %s\n", SDL_GetError()); exit(1); }
+    }
+}
+
+static void tpool_stop(ThreadPool* p){
+    if (p->nw == 0) return;
+    SDL_LockMutex(p->lock);
+    atomic_store(&p->quit, true);
+    SDL_CondBroadcast(p->wake);
+    SDL_UnlockMutex(p->lock);
+    for (int w=1; w<p->nw; w++) SDL_WaitThread(p->th[w], NULL);
+    SDL_DestroyCond(p->wake);
+    SDL_DestroyMutex(p->lock);
+    aligned_free64(p->dq);
+    free(p->th); free(p->wk);
+    memset(p, 0, sizeof(*p));
+}
+
+// Una epoca: fn sobre [0, units) repartido entre todos los hilos; vuelve cuando
+// todos terminaron (el principal trabaja como hilo 0).
+static void tpool_run(ThreadPool* p, long units, TPoolFn fn, void* ctx){
+    const int nw = p->nw;
+    p->fn = fn;
+    p->ctx = ctx;
+    for (int w=0; w<nw; w++)
+        atomic_store_explicit(&p->dq[w].range, tpool_pack(units*w/nw, units*(w+1)/nw), memory_order_relaxed);
+    atomic_store_explicit(&p->left, units, memory_order_relaxed);
+    atomic_store_explicit(&p->done, 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->epoch, 1, memory_order_release);   // publica fn, ctx y rangos
+    SDL_LockMutex(p->lock);
+    SDL_CondBroadcast(p->wake);
+    SDL_UnlockMutex(p->lock);
+    uint64_t tb = tpool_work(p, 0);
+    int spin = 0;
+    while (atomic_load_explicit(&p->done, memory_order_acquire) < nw - 1) tpool_wait(&spin);
+    trace_end(TR_BARRIER, tb, 0);
+    p->epochs++;
+}
+
+// Las unidades son contiguas en el orden plano de los puntos (figuras o bloques):
+// un rango de unidades es un solo rango de puntos.
+typedef struct { Scene* sc; LoopKind loop; int w, h; } TPoolUpdate;
+
+static void tpool_update_units(void* ctx, long u0, long u1){
+    const TPoolUpdate* pu = (const TPoolUpdate*)ctx;
+    Scene* sc = pu->sc;
+    size_t k0, k1, e0, e1;
+    scene_unit_range(sc, pu->loop, u0, &k0, &e0);
+    scene_unit_range(sc, pu->loop, u1-1, &e1, &k1);
+    (void)e0; (void)e1;
+    if (sc->layout == LAYOUT_SOA) bounce_soa(&sc->soa, &sc->soa, k0, k1-k0, (float)pu->w, (float)pu->h);
+    else for (size_t q=k0; q<k1; q++) bounce(&sc->pool[q], pu->w, pu->h);
+}
+
+static void update_pool(Scene* sc, LoopKind loop, int w, int h){
+    TPoolUpdate pu = { sc, loop, w, h };
+    tpool_run(&g_tpool, scene_units(sc, loop), tpool_update_units, &pu);
+}
+
+static void scene_update(Scene* sc, RunMode mode, LoopKind loop, int w, int h){
+    // SEQ: un solo evento update en el hilo principal; OMP y POOL: uno por hilo
+    if (mode == MODE_POOL){ update_pool(sc, loop, w, h); return; }
+    uint64_t tt = (mode == MODE_SEQ)? trace_begin() : 0;
+    if (sc->layout == LAYOUT_SOA){
+        if (mode == MODE_SEQ)         update_soa_seq(&sc->soa, sc->total, w, h);
+        else if (loop == LOOP_POINT)  update_soa_omp(&sc->soa, sc->total, w, h);
+        else                          update_soa_omp_shapes(&sc->soa, sc->first, sc->num_shapes, w, h);
+    } else {
+        if (mode == MODE_SEQ)         update_seq(sc->shapes, sc->num_shapes, w, h);
+        else if (loop == LOOP_POINT)  update_omp_points(sc->shapes, sc->first, sc->num_shapes, sc->total, w, h);
+        else                          update_omp(sc->shapes, sc->num_shapes, w, h);
+    }
+    if (mode == MODE_SEQ) trace_end(TR_UPDATE, tt, (uint32_t)sc->num_shapes);
+}
+
+// ---------- Simulacion analitica (--sim analytic) ----------
+// Cada eje de un punto se mueve con velocidad constante entre choques, asi que su
+// posicion en el paso t sale en forma cerrada del estado inicial, sin pasar por los
+// pasos intermedios. Con la semantica de bounce() (al pasar un borde el punto queda
+// en el borde y la velocidad se invierte, sin reflejar lo que sobro) el primer choque
+// llega en el paso hit = floor(d/|v|)+1 (d: distancia a la pared hacia la que va) y
+// desde ahi el movimiento es periodico: K = floor(L/|v|)+1 pasos de pared a pared,
+// periodo 2K. hit y K se recalculan en cada frame dentro del kernel, asi que no hay
+// estado extra: por punto se leen p0,v (16 bytes, la escena base, que nunca se
+// escribe) y se escriben x,y (8 bytes) en una vista SoA, contra 16+16 del update por
+// pasos. A cambio son tres divisiones y unas 30 operaciones en double por eje (dos
+// por registro en SSE2): el frame tarda varias veces lo que un paso aunque mueva
+// menos bytes. Lo que se gana es memoria y que saltar a cualquier paso (--seek)
+// cuesta lo mismo que avanzar uno. Con float las cuentas serian el doble de anchas,
+// pero sus floor fallan por un paso entero en algunos ejes y ya no es bounce().
+// Las cuentas en double son exactas: L es entero, p0 y v son float, y los cocientes
+// que se truncan estan a mas de 2^-24 de un entero salvo que lo sean, asi que cada
+// floor es el exacto. Es la trayectoria de bounce() sin redondeo; el update por pasos
+// acumula el de x += v en float, que mueve choques enteros de paso (varios px tras
+// cientos de pasos). Por eso el checksum no es comparable con --sim step ([CHECK] lo
+// marca con sim=analytic); analytic_check lo contrasta con bounce() en double.
+#define ANALYTIC_CHECK_STEPS 600       // pasos contra los que el benchmark compara
+#define ANALYTIC_CHECK_TOL   1e-3      // px: tolerancia contra bounce() en double
+#define ANALYTIC_QUIET 1073741824.0    // 2^30: un eje que tarda mas en cruzar no rebota
+
+typedef struct {
+    Scene view;        // x,y del paso t en SoA; comparte figuras con la base, sin vx/vy
+    Scene full;        // estado completo solo para --checkpoint (se reserva al primer uso)
+    const Scene* base; // estado inicial (solo lectura hasta analytic_store)
+    float* xy;         // reserva de la vista
+    uint64_t t;        // paso evaluado
+} Analytic;
+
+// Eje (p0, v), con p0 en [0, L], en el paso t < 2^31. Sin ramas, para que el loop
+// vectorice: los floor son truncaciones a int32 de cocientes <= 2^30 (el divisor es
+// max(|v|, L/2^30) en aritmetica, que es exacta aqui), la distancia a la pared sale
+// del signo de v, y cada select tiene sus dos lados usados tambien en la condicion;
+// un select sobre un operando de una division o conversion el compilador lo hunde en
+// ramas y el loop deja de vectorizar.
+static inline float tri_axis(float p0f, float vf, double L, double t, float* vo){
+    const double p0 = p0f, v = vf, a = fabs(v), s = copysign(1.0, v);
+    const double amin = L * (1.0/ANALYTIC_QUIET);
+    const double ac = 0.5*((a + amin) + fabs(a - amin));    // max(a, amin): cocientes <= 2^30
+    const double K = (double)(int32_t)(L / ac) + 1.0;        // pasos de pared a pared
+    const double d = 0.5*L + s*(0.5*L - p0);                 // hasta la pared hacia la que va
+    const double h = (double)(int32_t)(d / ac) + 1.0;        // paso del primer choque
+    const double hit = (a > amin)? h : INFINITY;             // quieto: nunca llega
+    const double u = t - h + K*(0.5 - 0.5*s);                // fase: 0 = en la pared L
+    const double P = 2.0*K, m = u - (double)(int32_t)(u / P) * P;
+    const double up = (m - K)*a, down = (L - K*a) - up;      // down = L - m*a
+    const double tri = (up > down)? up : down;
+    const double f0 = p0 + t*v, f1 = (f0 > 0.0)? f0 : 0.0, fr = (f1 < L)? f1 : L;
+    const bool before = (t < hit);
+    *vo = (float)(before? v : (up > down)? a : -a);
+    return (float)(before? fr : tri);
+}
+
+static void analytic_init(Analytic* an, const Scene* base){
+    memset(an, 0, sizeof(*an));
+    const size_t np = (base->total + 15) & ~(size_t)15;   // y en su propia linea de cache
+    float* f = (float*)aligned_alloc64(sizeof(float) * 2 * np);
+    an->base = base;
+    an->view = *base;
+    an->view.layout = LAYOUT_SOA;
+    an->view.pool = NULL;
+    an->view.arena = NULL;
+    an->view.map = NULL;
+    an->view.soa = (PointsSoA){ f, f + np, NULL, NULL };
+    an->xy = f;
+    memset(f, 0, sizeof(float) * 2 * np);
+}
+
+static void analytic_free(Analytic* an){
+    if (an->full.arena) scene_free(&an->full);
+    if (an->xy) aligned_free64(an->xy);
+    memset(an, 0, sizeof(*an));
+}
+
+// Posiciones del paso t en la vista (lo unico que se escribe por frame)
+static void analytic_eval(Analytic* an, uint64_t t, const Args* a){
+    an->t = (t < ANALYTIC_MAX_STEP)? t : ANALYTIC_MAX_STEP - 1;   // despues queda fijo
+    const Scene* b = an->base;
+    const double tt = (double)an->t, w = (double)a->winW, h = (double)a->winH;
+    float *x = an->view.soa.x, *y = an->view.soa.y;
+    const size_t total = b->total;
+    const long nblocks = (long)((total + SOA_BLOCK - 1) / SOA_BLOCK);
+    uint64_t tr = trace_begin();
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if(a->mode != MODE_SEQ)
+#endif
+    for (long blk=0; blk<nblocks; blk++){
+        const size_t k0 = (size_t)blk*SOA_BLOCK;
+        const size_t k1 = (k0 + SOA_BLOCK < total)? k0 + SOA_BLOCK : total;
+        float qx, qy;
+        if (b->layout == LAYOUT_SOA){
+            const float *x0 = b->soa.x, *y0 = b->soa.y, *vx0 = b->soa.vx, *vy0 = b->soa.vy;
+#ifdef _OPENMP
+            #pragma omp simd private(qx, qy)
+#endif
+            for (size_t k=k0; k<k1; k++){
+                x[k] = tri_axis(x0[k], vx0[k], w, tt, &qx);
+                y[k] = tri_axis(y0[k], vy0[k], h, tt, &qy);
+            }
+        } else {
+            const Point* P = b->pool;
+#ifdef _OPENMP
+            #pragma omp simd private(qx, qy)
+#endif
+            for (size_t k=k0; k<k1; k++){
+                x[k] = tri_axis(P[k].x, P[k].vx, w, tt, &qx);
+                y[k] = tri_axis(P[k].y, P[k].vy, h, tt, &qy);
+            }
+        }
+    }
+    trace_end(TR_UPDATE, tr, (uint32_t)nblocks);
+}
+
+// Estado completo (con velocidades) del paso evaluado en dst, en su layout. dst puede
+// ser la misma escena base: cada k lee p0,v y despues los pisa, pero la forma cerrada
+// ya no sirve despues; por eso en la base solo se hace al final (checksum, --save-state).
+static void analytic_store(const Analytic* an, Scene* dst, const Args* a){
+    const Scene* b = an->base;
+    const double tt = (double)an->t, w = (double)a->winW, h = (double)a->winH;
+    const long total = (long)dst->total;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (long k=0; k<total; k++){
+        Point p;
+        if (b->layout == LAYOUT_SOA){ p.x = b->soa.x[k]; p.y = b->soa.y[k]; p.vx = b->soa.vx[k]; p.vy = b->soa.vy[k]; }
+        else p = b->pool[k];
+        Point q;
+        q.x = tri_axis(p.x, p.vx, w, tt, &q.vx);
+        q.y = tri_axis(p.y, p.vy, h, tt, &q.vy);
+        if (dst->layout == LAYOUT_SOA){
+            dst->soa.x[k] = q.x; dst->soa.y[k] = q.y; dst->soa.vx[k] = q.vx; dst->soa.vy[k] = q.vy;
+        } else {
+            dst->pool[k] = q;
+        }
+    }
+}
+
+// Instantanea periodica: copia aparte de la base (reservada la primera vez) con el
+// estado del paso actual; la base no se toca.
+static const Scene* analytic_snapshot(Analytic* an, const Args* a){
+    if (!an->full.arena) scene_clone(&an->full, an->base, a->loop);
+    analytic_store(an, &an->full, a);
+    return &an->full;
+}
+
+// bounce() en double: la referencia contra la que se mide la forma cerrada.
+static inline void bounce_ref(double* p, double* v, double lim){
+    *p += *v;
+    if (*p < 0.0){ *p = 0.0; *v = -*v; }
+    else if (*p > lim){ *p = lim; *v = -*v; }
+}
+
+// Compara la forma cerrada tras n pasos (benchmark) con bounce() en double, que debe
+// quedar dentro de ANALYTIC_CHECK_TOL (ref_err, ref_bad: puntos fuera), y con n
+// updates por pasos en float desde la misma escena (step_err, step_pct: % a < 0.01 px).
+static void analytic_check(const Args* a, long n, double* ref_err, long* ref_bad,
+                           double* step_err, double* step_pct){
+    Scene base, step;
+    Args b = *a;
+    if (b.mode == MODE_POOL) b.mode = MODE_OMP;   // sin pool arrancado; el resultado es el mismo
+    scene_init(&base, &b);
+    scene_clone(&step, &base, b.loop);
+    for (long k=0; k<n; k++) scene_update(&step, b.mode, b.loop, b.winW, b.winH);
+    Analytic an;
+    analytic_init(&an, &base);
+    analytic_eval(&an, (uint64_t)n, &b);
+    double rworst = 0.0, sworst = 0.0;
+    long bad = 0;
+    size_t close = 0;
+    const long total = (long)base.total;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) reduction(max:rworst,sworst) reduction(+:bad,close)
+#endif
+    for (long k=0; k<total; k++){
+        Point p0, ps;
+        if (base.layout == LAYOUT_SOA){
+            p0 = (Point){ base.soa.x[k], base.soa.y[k], base.soa.vx[k], base.soa.vy[k] };
+            ps = (Point){ step.soa.x[k], step.soa.y[k], 0.0f, 0.0f };
+        } else { p0 = base.pool[k]; ps = step.pool[k]; }
+        double rx = p0.x, ry = p0.y, vx = p0.vx, vy = p0.vy;
+        for (long j=0; j<n; j++){ bounce_ref(&rx, &vx, b.winW); bounce_ref(&ry, &vy, b.winH); }
+        const double ex = an.view.soa.x[k], ey = an.view.soa.y[k];
+        const double er = fmax(fabs(rx - ex), fabs(ry - ey));
+        const double es = fmax(fabs((double)ps.x - ex), fabs((double)ps.y - ey));
+        if (er > rworst) rworst = er;
+        if (er > ANALYTIC_CHECK_TOL) bad++;
+        if (es > sworst) sworst = es;
+        if (es < 0.01) close++;
+    }
+    *ref_err = rworst;
+    *ref_bad = bad;
+    *step_err = sworst;
+    *step_pct = total? 100.0*(double)close/(double)total : 100.0;
+    analytic_free(&an);
+    scene_free(&step);
+    scene_free(&base);
+}
+
+// ---------- Update fuera de lugar (pipeline) ----------
+// Figuras por bloque en AoS; en SoA el bloque es SOA_BLOCK puntos.
+#define PIPE_SHAPES 64
+
+static int scene_nblocks(const Scene* sc){
+    if (sc->layout == LAYOUT_SOA) return (int)((sc->total + SOA_BLOCK - 1) / SOA_BLOCK);
+    return (sc->num_shapes + PIPE_SHAPES - 1) / PIPE_SHAPES;
+}
+
+// dst = un paso de src para el bloque b. Solo lee src, asi que el render puede
+// leer src al mismo tiempo sin locks.
+static void scene_step_block(const Scene* src, Scene* dst, int b, int w, int h){
+    if (src->layout == LAYOUT_SOA){
+        size_t n = src->total;
+        size_t k0 = (size_t)b * SOA_BLOCK;
+        size_t len = (n - k0 < SOA_BLOCK)? (n - k0) : SOA_BLOCK;
+        bounce_soa(&src->soa, &dst->soa, k0, len, (float)w, (float)h);
+    } else {
+        int s1 = (b+1)*PIPE_SHAPES < src->num_shapes? (b+1)*PIPE_SHAPES : src->num_shapes;
+        for (int s=b*PIPE_SHAPES; s<s1; s++){
+            const Point* P = src->shapes[s].points;
+            Point* Q = dst->shapes[s].points;
+            for (int i=0;i<src->shapes[s].n;i++){
+                Q[i] = P[i];
+                bounce(&Q[i], w, h);
+            }
+        }
+    }
+}
+
+// ---------- Render ----------
+// El fondo lo limpia render_frame() (antes de las estelas).
+static void render(SDL_Renderer* R, const Scene* sc){
+    for (int s=0; s<sc->num_shapes; s++){
+        const int pts = sc->shapes[s].n;
+        const SDL_Color c = sc->shapes[s].color;
+        SDL_SetRenderDrawColor(R, c.r, c.g, c.b, 255);
+        for (int i=0;i<pts;i++){
+            int j = (i+1)%pts;
+            float x0, y0, x1, y1;
+            scene_point(sc, s, i, &x0, &y0);
+            scene_point(sc, s, j, &x1, &y1);
+            SDL_RenderDrawLine(R, (int)x0, (int)y0, (int)x1, (int)y1);
+        }
+    }
+}
+
+// ---------- Render por lotes ----------
+// Aristas por llamada a SDL_RenderGeometry (4 vertices y 6 indices por arista).
+#define GEOM_BATCH_EDGES 16384
+
+// Buffers reutilizados entre frames: el orden por color se calcula una vez
+// (los colores no cambian) y los vertices se reescriben cada frame.
+typedef struct {
+    int* order;                 // figuras ordenadas por indice de PALETTE
+    int bucket[16];             // inicio de cada color en order (PALETTE_SIZE+1 usados)
+    SDL_FPoint* line;           // max_pts+1 puntos: un poligono cerrado
+    SDL_Vertex* verts;          // GEOM_BATCH_EDGES*4
+    int* idx;                   // GEOM_BATCH_EDGES*6
+} RenderBatch;
+
+static void batch_init(RenderBatch* b, const Scene* sc, RenderPath path){
+    memset(b, 0, sizeof(*b));
+    if (path == RENDER_LEGACY) return;
+
+    // Counting sort por color
+    b->order = (int*)malloc(sizeof(int)*sc->num_shapes);
+    if (!b->order){ fprintf(stderr,"[ERR] sin memoria (batch)\n"); exit(3); }
+    int count[16] = {0};
+    for (int s=0; s<sc->num_shapes; s++) count[sc->shapes[s].pal]++;
+    for (int c=0; c<PALETTE_SIZE; c++) b->bucket[c+1] = b->bucket[c] + count[c];
+    int fill[16];
+    memcpy(fill, b->bucket, sizeof(fill));
+    for (int s=0; s<sc->num_shapes; s++) b->order[fill[sc->shapes[s].pal]++] = s;
+
+    if (path == RENDER_BATCH){
+        b->line = (SDL_FPoint*)malloc(sizeof(SDL_FPoint)*(sc->max_pts+1));
+        if (!b->line){ fprintf(stderr,"[ERR] sin memoria (batch)\n"); exit(3); }
+    } else {
+        b->verts = (SDL_Vertex*)malloc(sizeof(SDL_Vertex)*GEOM_BATCH_EDGES*4);
+        b->idx = (int*)malloc(sizeof(int)*GEOM_BATCH_EDGES*6);
+        if (!b->verts || !b->idx){ fprintf(stderr,"[ERR] sin memoria (batch)\n"); exit(3); }
+        // Los indices solo dependen de la posicion de la arista en el lote
+        for (int e=0; e<GEOM_BATCH_EDGES; e++){
+            int v = e*4;
+            int* q = &b->idx[e*6];
+            q[0]=v; q[1]=v+1; q[2]=v+2; q[3]=v+2; q[4]=v+1; q[5]=v+3;
+        }
+    }
+}
+
+static void batch_free(RenderBatch* b){
+    free(b->order); free(b->line); free(b->verts); free(b->idx);
+    memset(b, 0, sizeof(*b));
+}
+
+// Un SDL_RenderDrawLinesF por figura; color solo cambia PALETTE_SIZE veces.
+static void render_batch_lines(SDL_Renderer* R, const Scene* sc, RenderBatch* b){
+    for (int c=0; c<PALETTE_SIZE; c++){
+        if (b->bucket[c] == b->bucket[c+1]) continue;
+        SDL_SetRenderDrawColor(R, PALETTE[c][0], PALETTE[c][1], PALETTE[c][2], 255);
+        for (int k=b->bucket[c]; k<b->bucket[c+1]; k++){
+            int s = b->order[k];
+            const int pts = sc->shapes[s].n;
+            for (int i=0;i<pts;i++) scene_point(sc, s, i, &b->line[i].x, &b->line[i].y);
+            b->line[pts] = b->line[0];   // cerrar el poligono
+            SDL_RenderDrawLinesF(R, b->line, pts+1);
+        }
+    }
+}
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+// Cada arista como un quad de 1 px de ancho; el color va en el vertice, asi que
+// un lote mezcla colores y solo se hace una llamada cada GEOM_BATCH_EDGES aristas.
+static void render_batch_geom(SDL_Renderer* R, const Scene* sc, RenderBatch* b){
+    int ne = 0;
+    for (int k=0; k<sc->num_shapes; k++){
+        int s = b->order[k];
+        const int pts = sc->shapes[s].n;
+        SDL_Color col = sc->shapes[s].color;
+        for (int i=0;i<pts;i++){
+            float x0, y0, x1, y1;
+            scene_point(sc, s, i, &x0, &y0);
+            scene_point(sc, s, (i+1)%pts, &x1, &y1);
+            float dx = x1-x0, dy = y1-y0;
+            float len = sqrtf(dx*dx + dy*dy);
+            if (len < 1e-3f) continue;
+            float nx = -dy/len*0.5f, ny = dx/len*0.5f;   // media normal
+            SDL_Vertex* v = &b->verts[ne*4];
+            v[0].position.x = x0+nx; v[0].position.y = y0+ny;
+            v[1].position.x = x0-nx; v[1].position.y = y0-ny;
+            v[2].position.x = x1+nx; v[2].position.y = y1+ny;
+            v[3].position.x = x1-nx; v[3].position.y = y1-ny;
+            for (int q=0;q<4;q++){ v[q].color = col; v[q].tex_coord.x = 0.f; v[q].tex_coord.y = 0.f; }
+            if (++ne == GEOM_BATCH_EDGES){
+                SDL_RenderGeometry(R, NULL, b->verts, ne*4, b->idx, ne*6);
+                ne = 0;
+            }
+        }
+    }
+    if (ne > 0) SDL_RenderGeometry(R, NULL, b->verts, ne*4, b->idx, ne*6);
+}
+#endif
+
+static void render_batched(SDL_Renderer* R, const Scene* sc, RenderBatch* b, RenderPath path){
+#if SDL_VERSION_ATLEAST(2,0,18)
+    if (path == RENDER_GEOM) render_batch_geom(R, sc, b);
+    else
+#endif
+    render_batch_lines(R, sc, b);
+    (void)path;
+}
+
+// ---------- Estelas ----------
+// Atenuacion por frame en /256, elegida para que tras len frames quede 1/64 del
+// brillo (lo mismo que corta el ring buffer). Con len=64 da 238 = 256-18, el alpha
+// de fade_surface en Screen.py.
+static uint32_t trail_fade(int len){
+    return (uint32_t)lround(256.0 * pow(1.0/64.0, 1.0/(double)len));
+}
+
+// Ultimas len posiciones de cada punto en un ring buffer reservado una sola vez.
+// La ranura j ocupa [j*total, (j+1)*total) en x/y, con el orden plano de first[].
+typedef struct {
+    int len;            // ranuras (--trail)
+    int head;           // proxima ranura a escribir
+    int filled;         // ranuras con datos (<= len)
+    size_t total;       // puntos por ranura
+    float *x, *y;       // len*total, alineados a 64 bytes
+    SDL_FPoint* line;   // max_pts+1 puntos
+    float weight[TRAIL_MAX+1];   // brillo por edad: (trail_fade(len)/256)^edad
+} TrailHist;
+
+static void trail_init(TrailHist* t, const Scene* sc, int len){
+    memset(t, 0, sizeof(*t));
+    t->len = len;
+    t->total = sc->total;
+    t->x = (float*)aligned_alloc64(sizeof(float)*(size_t)len*sc->total);
+    t->y = (float*)aligned_alloc64(sizeof(float)*(size_t)len*sc->total);
+    t->line = (SDL_FPoint*)malloc(sizeof(SDL_FPoint)*(sc->max_pts+1));
+    if (!t->line){ fprintf(stderr,"[ERR] sin memoria (trail)\n"); exit(3); }
+    t->weight[0] = 1.0f;
+    for (int k=1; k<=TRAIL_MAX; k++) t->weight[k] = t->weight[k-1] * (float)trail_fade(len) / 256.0f;
+}
+
+static void trail_free(TrailHist* t){
+    if (t->x) aligned_free64(t->x);
+    if (t->y) aligned_free64(t->y);
+    free(t->line);
+    memset(t, 0, sizeof(*t));
+}
+
+// Guarda las posiciones actuales en la ranura head (sin reservar memoria).
+static void trail_push(TrailHist* t, const Scene* sc){
+    float* x = t->x + (size_t)t->head*t->total;
+    float* y = t->y + (size_t)t->head*t->total;
+    if (sc->layout == LAYOUT_SOA){
+        memcpy(x, sc->soa.x, sizeof(float)*t->total);
+        memcpy(y, sc->soa.y, sizeof(float)*t->total);
+    } else {
+        for (size_t k=0; k<t->total; k++){ x[k] = sc->pool[k].x; y[k] = sc->pool[k].y; }
+    }
+    t->head = (t->head + 1) % t->len;
+    if (t->filled < t->len) t->filled++;
+}
+
+// Historial de la mas vieja a la mas nueva, cada edad con el color atenuado; si
+// hay orden por color (batch) el color solo cambia PALETTE_SIZE veces por edad.
+static void trail_draw(SDL_Renderer* R, const Scene* sc, TrailHist* t, const int* order){
+    for (int age=t->filled; age>=1; age--){
+        int slot = (t->head - age + t->len) % t->len;
+        const float* x = t->x + (size_t)slot*t->total;
+        const float* y = t->y + (size_t)slot*t->total;
+        float w = t->weight[age];
+        int last_pal = -1;
+        for (int k=0; k<sc->num_shapes; k++){
+            int s = order? order[k] : k;
+            const int pts = sc->shapes[s].n;
+            if (sc->shapes[s].pal != last_pal){
+                const SDL_Color c = sc->shapes[s].color;
+                SDL_SetRenderDrawColor(R, (Uint8)(c.r*w), (Uint8)(c.g*w), (Uint8)(c.b*w), 255);
+                last_pal = sc->shapes[s].pal;
+            }
+            const size_t f = sc->first[s];
+            for (int i=0;i<pts;i++){ t->line[i].x = x[f+i]; t->line[i].y = y[f+i]; }
+            t->line[pts] = t->line[0];
+            SDL_RenderDrawLinesF(R, t->line, pts+1);
+        }
+    }
+}
+
+// ---------- Render CPU por tiles ----------
+#define TILE 64
+#define BG_ARGB 0xFF030306u   // mismo fondo (3,3,6) que render()
+
+typedef struct {
+    uint32_t* px;    // ARGB8888, pitch = w*4
+    int w, h;
+} Framebuffer;
+
+// Arista de relleno: filas [y0, y1) cuyo centro (y + 0.5) cruza, y x en el centro de la
+// fila y0. La x de la fila y es x + (y - y0)*dxdy, sin acumular: no depende de la banda.
+typedef struct {
+    float x, dxdy;
+    int y0;
+    int y1d;         // (y1 << 1) | 1 si la arista sube (winding -1 en nonzero)
+} FillEdge;
+
+// Las aristas se reparten (binning) en tiles de TILE x TILE. Cada hilo cuenta y
+// llena sus propias listas para un rango contiguo de figuras, y el prefijo se toma
+// por (tile, hilo): asi cada tile ve sus aristas en orden de figura, igual que el
+// pintor de render(), sin atomicos y con resultado determinista.
+typedef struct {
+    Framebuffer fb;
+    SDL_Texture* tex;       // streaming; se actualiza una vez por frame
+    int tiles_x, tiles_y, ntiles;
+    int nthreads;
+    int* cursor;            // nthreads*ntiles: conteo y luego posicion de escritura
+    int* start;             // ntiles+1
+    uint32_t* refs;         // EDGE_ID(s,i) por tile
+    size_t refs_cap;
+    uint32_t fade;          // 0: limpiar cada frame; si no, canal*fade/256 (--trail-mode decay)
+    float thick;            // 0: lineas de 1 px sin AA; si no, grosor de las lineas AA
+    int pad;                // px que una linea AA pinta fuera de su eje (binning y cajas)
+    // --fill: tabla de aristas por figura y figuras por banda (fila de tiles), con el
+    // mismo conteo + prefijo por (banda, hilo) que los tiles
+    FillRule fill;
+    uint32_t fill_k;        // opacidad del relleno en 0..256
+    int nbands;
+    FillEdge* fe;           // aristas de la figura s en fe[first[s]..], ordenadas por y0
+    size_t fe_cap;
+    uint8_t* fe_n;          // aristas de relleno por figura (sin las horizontales)
+    int* fy;                // 2 por figura: filas [y0, y1) que cubre su relleno
+    int fshapes_cap;
+    int* bcursor;           // nthreads*nbands
+    int* bstart;            // nbands+1
+    uint32_t* brefs;        // figuras de cada banda, en orden de figura
+    size_t brefs_cap;
+    uint64_t fill_ticks, fill_px;   // acumulados: pasada de bandas y pixeles rellenados
+    long fill_frames;
+} CpuRaster;
+
+static void cpu_raster_init(CpuRaster* c, SDL_Renderer* R, int w, int h, uint32_t fade, float thick,
+                            FillRule fill, int fill_alpha){
+    memset(c, 0, sizeof(*c));
+    c->fb.w = w; c->fb.h = h;
+    c->fade = fade;
+    c->thick = thick;
+    c->fill = fill;
+    c->fill_k = ((uint32_t)fill_alpha*256u + 127u) / 255u;   // 255 -> 256: opaco
+    // Alcance de la cobertura (medio grosor + 0.5) medido en el eje menor (hasta x sqrt(2)),
+    // mas el truncado a int de los extremos que usa el binning
+    c->pad = (thick > 0.0f)? (int)ceilf((0.5f*thick + 0.5f) * 1.4143f) + 2 : 0;
+    c->fb.px = (uint32_t*)aligned_alloc64(sizeof(uint32_t)*(size_t)w*h);
+    for (size_t k=0; k<(size_t)w*h; k++) c->fb.px[k] = BG_ARGB;
+    c->tex = SDL_CreateTexture(R, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+    if (!c->tex){ fprintf(stderr,"[ERR] SDL_CreateTexture: %s\n", SDL_GetError()); exit(1); }
+    c->tiles_x = (w + TILE-1)/TILE;
+    c->tiles_y = (h + TILE-1)/TILE;
+    c->ntiles = c->tiles_x * c->tiles_y;
+    c->nthreads = omp_get_max_threads();
+    c->cursor = (int*)malloc(sizeof(int)*(size_t)c->nthreads*c->ntiles);
+    c->start = (int*)malloc(sizeof(int)*(size_t)(c->ntiles+1));
+    if (!c->cursor || !c->start){ fprintf(stderr,"[ERR] sin memoria (raster)\n"); exit(3); }
+    if (fill != FILL_NONE){
+        c->nbands = c->tiles_y;
+        c->bcursor = (int*)malloc(sizeof(int)*(size_t)c->nthreads*c->nbands);
+        c->bstart = (int*)malloc(sizeof(int)*(size_t)(c->nbands+1));
+        if (!c->bcursor || !c->bstart){ fprintf(stderr,"[ERR] sin memoria (relleno)\n"); exit(3); }
+    }
+}
+
+static void cpu_raster_free(CpuRaster* c){
+    aligned_free64(c->fb.px);
+    if (c->tex) SDL_DestroyTexture(c->tex);
+    free(c->cursor); free(c->start); free(c->refs);
+    free(c->fe); free(c->fe_n); free(c->fy); free(c->bcursor); free(c->bstart); free(c->brefs);
+    memset(c, 0, sizeof(*c));
+}
+
+// Atenua n pixeles hacia negro: R y B en una multiplicacion empaquetada y G en otra
+// (255*255 cabe en 16 bits, no hay acarreo entre canales). Sin ramas: omp simd.
+static inline void fade_row(uint32_t* px, int n, uint32_t k){
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (int x=0; x<n; x++){
+        uint32_t p = px[x];
+        uint32_t rb = ((p & 0x00FF00FFu) * k >> 8) & 0x00FF00FFu;
+        uint32_t g  = ((p & 0x0000FF00u) * k >> 8) & 0x0000FF00u;
+        px[x] = 0xFF000000u | rb | g;
+    }
+}
+
+static inline int clampi(int v, int lo, int hi){ return v<lo? lo : (v>hi? hi : v); }
+
+// Pendiente en punto fijo 16.16 y coordenada del eje menor en a (redondeo al
+// mas cercano). Binning y raster usan exactamente esta formula.
+static inline int64_t line_slope(int a0, int b0, int a1, int b1){
+    return (a1!=a0)? (((int64_t)(b1-b0) * 65536) / (a1-a0)) : 0;
+}
+static inline int line_minor(int a, int a0, int b0, int64_t slope){
+    return b0 + (int)(((int64_t)(a-a0)*slope + 32768) >> 16);
+}
+
+// Linea de 1 px recortada al rectangulo [cx0,cx1) x [cy0,cy1). Cada pixel depende
+// solo de la arista (eje mayor + redondeo del menor), no del tile, asi que las
+// aristas que cruzan varios tiles no dejan costuras.
+static void raster_line_clip(Framebuffer* fb, int x0, int y0, int x1, int y1, uint32_t argb,
+                             int cx0, int cy0, int cx1, int cy1){
+    if (abs(x1-x0) >= abs(y1-y0)){
+        if (x0 > x1){ int t=x0; x0=x1; x1=t; t=y0; y0=y1; y1=t; }
+        int64_t m = line_slope(x0, y0, x1, y1);
+        int xa = x0>cx0? x0:cx0, xb = x1<cx1-1? x1:cx1-1;
+        int64_t acc = (int64_t)(xa-x0)*m + 32768;   // DDA: line_minor incremental
+        for (int x=xa; x<=xb; x++, acc+=m){
+            int y = y0 + (int)(acc >> 16);
+            if (y>=cy0 && y<cy1) fb->px[(size_t)y*fb->w + x] = argb;
+            else if ((m >= 0)? (y >= cy1) : (y < cy0)) break;   // ya salio del tile
+        }
+    } else {
+        if (y0 > y1){ int t=x0; x0=x1; x1=t; t=y0; y0=y1; y1=t; }
+        int64_t m = line_slope(y0, x0, y1, x1);
+        int ya = y0>cy0? y0:cy0, yb = y1<cy1-1? y1:cy1-1;
+        int64_t acc = (int64_t)(ya-y0)*m + 32768;
+        for (int y=ya; y<=yb; y++, acc+=m){
+            int x = x0 + (int)(acc >> 16);
+            if (x>=cx0 && x<cx1) fb->px[(size_t)y*fb->w + x] = argb;
+            else if ((m >= 0)? (x >= cx1) : (x < cx0)) break;
+        }
+    }
+}
+
+// Sin comparaciones, para que los loops omp simd no tengan ramas: clamp a [0,1].
+static inline float clamp01(float v){ return 0.5f*(fabsf(v) - fabsf(v - 1.0f) + 1.0f); }
+
+// Linea AA de grosor 2*hw recortada al rectangulo [cx0,cx1) x [cy0,cy1). Cobertura de
+// Wu generalizada: 1 - distancia (perpendicular) del centro del pixel al borde de la
+// banda, y media cobertura en los extremos. Con hw = 0.5 y lineas rectas da los mismos
+// pesos que Wu. Se recorre por filas: en cada una la banda es un tramo contiguo de
+// pixeles que se calcula y mezcla en un solo loop sin ramas (omp simd, R|B y G
+// empaquetados como fade_row). La cobertura depende solo de la arista: sin costuras.
+static void raster_line_aa(Framebuffer* fb, float ax, float ay, float bx, float by, uint32_t argb,
+                           float hw, int cx0, int cy0, int cx1, int cy1){
+    const float dx = bx-ax, dy = by-ay, len = sqrtf(dx*dx + dy*dy);
+    float ux = 1.0f, uy = 0.0f;
+    if (len > 1e-6f){ ux = dx/len; uy = dy/len; }
+    const float r = hw + 0.5f;
+    int ya = (int)floorf((ay<by? ay:by) - r), yb = (int)ceilf((ay>by? ay:by) + r);
+    ya = ya>cy0? ya:cy0; yb = yb<cy1-1? yb:cy1-1;
+    const uint32_t srb = argb & 0x00FF00FFu, sg = argb & 0x0000FF00u;
+    for (int y=ya; y<=yb; y++){
+        // Relativo al extremo a: distancia d = c - X*uy, avance t = X*ux + q
+        const float py = (float)y + 0.5f - ay, c = py*ux, q = py*uy;
+        float lo = -1e9f, hi = 1e9f;
+        if (fabsf(uy) > 1e-6f){
+            float u0 = (c - r)/uy, u1 = (c + r)/uy;
+            lo = u0<u1? u0:u1; hi = u0<u1? u1:u0;
+        } else if (fabsf(c) > r) continue;
+        if (fabsf(ux) > 1e-6f){
+            float u0 = (-0.5f - q)/ux, u1 = (len + 0.5f - q)/ux;
+            lo = (u0<u1? u0:u1) > lo? (u0<u1? u0:u1) : lo;
+            hi = (u0<u1? u1:u0) < hi? (u0<u1? u1:u0) : hi;
+        } else if (q < -0.5f || q > len + 0.5f) continue;
+        lo += ax; hi += ax;
+        if (hi < (float)cx0 || lo > (float)cx1) continue;
+        int xa = (int)floorf(lo - 0.5f), xb = (int)ceilf(hi - 0.5f);
+        xa = xa>cx0? xa:cx0; xb = xb<cx1-1? xb:cx1-1;
+        uint32_t* row = &fb->px[(size_t)y*fb->w];
+#ifdef _OPENMP
+        #pragma omp simd
+#endif
+        for (int x=xa; x<=xb; x++){
+            const float X = (float)x + 0.5f - ax;
+            const float t = X*ux + q;
+            const float end = 0.5f*(len - fabsf(2.0f*t - len));   // min(t, len-t)
+            const float cv = clamp01(r - fabsf(c - X*uy)) * clamp01(end + 0.5f);
+            const uint32_t k = (uint32_t)(int)(cv*256.0f + 0.5f), ik = 256u - k, p = row[x];
+            const uint32_t rb = (((p & 0x00FF00FFu)*ik + srb*k) >> 8) & 0x00FF00FFu;
+            const uint32_t g  = (((p & 0x0000FF00u)*ik + sg*k) >> 8) & 0x0000FF00u;
+            row[x] = 0xFF000000u | rb | g;
+        }
+    }
+}
+
+static inline uint32_t color_argb(SDL_Color c){
+    return 0xFF000000u | ((uint32_t)c.r<<16) | ((uint32_t)c.g<<8) | (uint32_t)c.b;
+}
+
+// Recorre los tiles que la linea realmente cruza (no toda su caja): por cada
+// columna (o fila) de tiles del eje mayor calcula el rango del eje menor con la
+// misma formula que raster_line_clip, ampliado c->pad px a cada lado para las lineas
+// AA. Con refs==NULL solo cuenta.
+static void bin_edge(const CpuRaster* c, int x0, int y0, int x1, int y1,
+                     int* cur, uint32_t* refs, uint32_t e){
+    const int W = c->fb.w, H = c->fb.h;
+    bool xmajor = abs(x1-x0) >= abs(y1-y0);
+    // Trabajamos en coordenadas (mayor, menor)
+    int a0 = xmajor? x0:y0, b0 = xmajor? y0:x0, a1 = xmajor? x1:y1, b1 = xmajor? y1:x1;
+    int amax = xmajor? W:H, bmax = xmajor? H:W;
+    if (a0 > a1){ int t=a0; a0=a1; a1=t; t=b0; b0=b1; b1=t; }
+    int64_t m = line_slope(a0, b0, a1, b1);
+    const int pad = c->pad;
+    int alo = a0-pad>0? a0-pad:0, ahi = a1+pad<amax-1? a1+pad:amax-1;
+    for (int ta = alo/TILE; alo <= ahi && ta <= ahi/TILE; ta++){
+        int sa = ta*TILE > alo? ta*TILE : alo;
+        int ea = ta*TILE+TILE-1 < ahi? ta*TILE+TILE-1 : ahi;
+        int bs = line_minor(clampi(sa, a0, a1), a0, b0, m);
+        int be = line_minor(clampi(ea, a0, a1), a0, b0, m);
+        if (bs > be){ int t=bs; bs=be; be=t; }
+        bs -= pad; be += pad;
+        if (be < 0 || bs >= bmax) continue;
+        bs = bs<0? 0:bs; be = be>bmax-1? bmax-1:be;
+        for (int tb = bs/TILE; tb <= be/TILE; tb++){
+            int k = xmajor? (tb*c->tiles_x + ta) : (ta*c->tiles_x + tb);
+            if (refs) refs[cur[k]++] = e;
+            else      cur[k]++;
+        }
+    }
+}
+
+// Limpia (o atenua con --trail-mode decay) el rectangulo [x0,x1) x [y0,y1).
+static void clear_rect(CpuRaster* c, int x0, int y0, int x1, int y1){
+    for (int y=y0; y<y1; y++){
+        uint32_t* row = &c->fb.px[(size_t)y*c->fb.w];
+        if (c->fade) fade_row(row + x0, x1 - x0, c->fade);
+        else for (int x=x0; x<x1; x++) row[x] = BG_ARGB;
+    }
+}
+
+// Rectangulo del tile k, limpiado; con --fill ya lo limpio la pasada de bandas.
+static void tile_clear(CpuRaster* c, int k, int* cx0, int* cy0, int* cx1, int* cy1){
+    *cx0 = (k % c->tiles_x)*TILE; *cy0 = (k / c->tiles_x)*TILE;
+    *cx1 = *cx0+TILE < c->fb.w? *cx0+TILE : c->fb.w;
+    *cy1 = *cy0+TILE < c->fb.h? *cy0+TILE : c->fb.h;
+    if (c->fill == FILL_NONE) clear_rect(c, *cx0, *cy0, *cx1, *cy1);
+}
+
+static inline void edge_ends(const Scene* sc, uint32_t e, int* x0, int* y0, int* x1, int* y1){
+    int s = (int)(e >> 7), i = (int)(e & (MAX_PTS-1));
+    float fx0, fy0, fx1, fy1;
+    scene_point(sc, s, i, &fx0, &fy0);
+    scene_point(sc, s, (i+1)%sc->shapes[s].n, &fx1, &fy1);
+    *x0 = (int)fx0; *y0 = (int)fy0; *x1 = (int)fx1; *y1 = (int)fy1;
+}
+
+// Pinta la arista e recortada a un tile: 1 px dura o AA con grosor (c->thick > 0).
+static inline void raster_edge(CpuRaster* c, const Scene* sc, uint32_t e, int cx0, int cy0, int cx1, int cy1){
+    const uint32_t argb = color_argb(sc->shapes[e >> 7].color);
+    if (c->thick > 0.0f){
+        int s = (int)(e >> 7), i = (int)(e & (MAX_PTS-1));
+        float ax, ay, bx, by;
+        scene_point(sc, s, i, &ax, &ay);
+        scene_point(sc, s, (i+1)%sc->shapes[s].n, &bx, &by);
+        raster_line_aa(&c->fb, ax,ay,bx,by, argb, 0.5f*c->thick, cx0,cy0,cx1,cy1);
+    } else {
+        int x0,y0,x1,y1;
+        edge_ends(sc, e, &x0,&y0,&x1,&y1);
+        raster_line_clip(&c->fb, x0,y0,x1,y1, argb, cx0,cy0,cx1,cy1);
+    }
+}
+
+// Relleno por scanlines (--fill). Cada figura arma una vez por frame su tabla de aristas (FillEdge ordenadas por fila
+// de entrada, sin las horizontales) y su rango de filas; despues cada banda de TILE
+// filas completas recorre, en orden de figura, las figuras que la cruzan con una tabla
+// de aristas activas: entran las que empiezan en la fila, salen las que terminan, y los
+// cortes con el centro de la fila se ordenan por x (insercion: la lista ya viene
+// ordenada de la fila anterior). Los pixeles con centro dentro de cada tramo se mezclan
+// con alpha en un loop omp simd. Los rellenos van bajo todas las aristas.
+
+static void fill_reserve(CpuRaster* c, const Scene* sc){
+    if (sc->total > c->fe_cap){
+        free(c->fe);
+        c->fe_cap = sc->total;
+        c->fe = (FillEdge*)malloc(sizeof(FillEdge)*c->fe_cap);
+    }
+    if (sc->num_shapes > c->fshapes_cap){
+        free(c->fe_n); free(c->fy);
+        c->fshapes_cap = sc->num_shapes;
+        c->fe_n = (uint8_t*)malloc((size_t)c->fshapes_cap);
+        c->fy = (int*)malloc(sizeof(int)*2*(size_t)c->fshapes_cap);
+    }
+    if (!c->fe || !c->fe_n || !c->fy){ fprintf(stderr,"[ERR] sin memoria (relleno)\n"); exit(3); }
+}
+
+// Tabla de aristas de la figura s: filas cuyo centro cae en [ya, yb) de cada arista,
+// recortadas a la pantalla, ordenadas (estable) por y0.
+static void fill_build(CpuRaster* c, const Scene* sc, int s){
+    const int n = sc->shapes[s].n, H = c->fb.h;
+    FillEdge* E = &c->fe[sc->first[s]];
+    int m = 0, ylo = H, yhi = 0;
+    float px, py;
+    scene_point(sc, s, n-1, &px, &py);
+    for (int i=0; i<n; i++){
+        float qx, qy;
+        scene_point(sc, s, i, &qx, &qy);
+        const bool up = qy < py;
+        const float ax = up? qx:px, ay = up? qy:py, bx = up? px:qx, by = up? py:qy;
+        px = qx; py = qy;
+        const int y0 = clampi((int)ceilf(ay - 0.5f), 0, H), y1 = clampi((int)ceilf(by - 0.5f), 0, H);
+        if (y0 >= y1) continue;
+        const float dxdy = (bx - ax) / (by - ay);
+        FillEdge e = { ax + ((float)y0 + 0.5f - ay)*dxdy, dxdy, y0, (y1 << 1) | (up? 1:0) };
+        int j = m++;
+        while (j > 0 && E[j-1].y0 > y0){ E[j] = E[j-1]; j--; }
+        E[j] = e;
+        ylo = y0 < ylo? y0 : ylo;
+        yhi = y1 > yhi? y1 : yhi;
+    }
+    c->fe_n[s] = (uint8_t)m;
+    c->fy[2*s] = m? ylo : 0;
+    c->fy[2*s+1] = m? yhi : 0;
+}
+
+// Mezcla los pixeles de row con centro en [xl, xr); devuelve cuantos pinto.
+static inline int fill_span(uint32_t* row, int w, float xl, float xr, uint32_t argb, uint32_t k){
+    xl = xl < 0.0f? 0.0f : (xl > (float)w? (float)w : xl);
+    xr = xr < 0.0f? 0.0f : (xr > (float)w? (float)w : xr);
+    const int xa = (int)ceilf(xl - 0.5f), xb = (int)ceilf(xr - 0.5f);
+    if (k >= 256u){
+        for (int x=xa; x<xb; x++) row[x] = argb;
+    } else {
+        const uint32_t srb = (argb & 0x00FF00FFu)*k, sg = (argb & 0x0000FF00u)*k, ik = 256u - k;
+#ifdef _OPENMP
+        #pragma omp simd
+#endif
+        for (int x=xa; x<xb; x++){
+            const uint32_t p = row[x];
+            const uint32_t rb = (((p & 0x00FF00FFu)*ik + srb) >> 8) & 0x00FF00FFu;
+            const uint32_t g  = (((p & 0x0000FF00u)*ik + sg) >> 8) & 0x0000FF00u;
+            row[x] = 0xFF000000u | rb | g;
+        }
+    }
+    return xb > xa? xb - xa : 0;
+}
+
+// Rellena las filas [ya, yb) de la figura s con su tabla de aristas activas.
+static uint64_t fill_shape(CpuRaster* c, const Scene* sc, int s, int ya, int yb){
+    const FillEdge* E = &c->fe[sc->first[s]];
+    const int m = c->fe_n[s], w = c->fb.w;
+    const int ye = c->fy[2*s+1] < yb? c->fy[2*s+1] : yb;
+    const uint32_t argb = color_argb(sc->shapes[s].color), k = c->fill_k;
+    uint8_t act[MAX_PTS];
+    float xs[MAX_PTS];
+    int na = 0, next = 0;
+    uint64_t px = 0;
+    for (int y = c->fy[2*s] > ya? c->fy[2*s] : ya; y < ye; y++){
+        int q = 0;
+        for (int j=0; j<na; j++) if ((E[act[j]].y1d >> 1) > y) act[q++] = act[j];
+        na = q;
+        for (; next < m && E[next].y0 <= y; next++)   // al entrar a la banda: las que ya venian
+            if ((E[next].y1d >> 1) > y) act[na++] = (uint8_t)next;
+        for (int j=0; j<na; j++) xs[j] = E[act[j]].x + (float)(y - E[act[j]].y0)*E[act[j]].dxdy;
+        for (int j=1; j<na; j++){
+            const float xv = xs[j];
+            const uint8_t av = act[j];
+            int i = j-1;
+            while (i >= 0 && xs[i] > xv){ xs[i+1] = xs[i]; act[i+1] = act[i]; i--; }
+            xs[i+1] = xv; act[i+1] = av;
+        }
+        uint32_t* row = &c->fb.px[(size_t)y*w];
+        if (c->fill == FILL_EVENODD){
+            for (int j=0; j+1<na; j+=2) px += (uint64_t)fill_span(row, w, xs[j], xs[j+1], argb, k);
+        } else {
+            int wn = 0;
+            float xl = 0.0f;
+            for (int j=0; j<na; j++){
+                if (wn == 0) xl = xs[j];
+                wn += (E[act[j]].y1d & 1)? -1 : 1;
+                if (wn == 0) px += (uint64_t)fill_span(row, w, xl, xs[j], argb, k);
+            }
+        }
+    }
+    return px;
+}
+
+// Cuenta (refs == NULL) o anota la figura s en las bandas que cruza su relleno.
+static inline void fill_bin(const CpuRaster* c, int s, int* cur, uint32_t* refs){
+    if (c->fy[2*s] >= c->fy[2*s+1]) return;
+    for (int b = c->fy[2*s]/TILE; b <= (c->fy[2*s+1]-1)/TILE; b++){
+        if (refs) refs[cur[b]++] = (uint32_t)s;
+        else      cur[b]++;
+    }
+}
+
+// Banda b: limpia sus filas (ancho completo) y rellena sus figuras en orden.
+static uint64_t fill_band(CpuRaster* c, const Scene* sc, int b){
+    uint64_t tt = trace_begin();
+    const int y0 = b*TILE, y1 = (y0+TILE < c->fb.h)? y0+TILE : c->fb.h;
+    clear_rect(c, 0, y0, c->fb.w, y1);
+    uint64_t px = 0;
+    for (int r=c->bstart[b]; r<c->bstart[b+1]; r++)
+        px += fill_shape(c, sc, (int)c->brefs[r], y0, y1);
+    trace_end(TR_FILL, tt, (uint32_t)b);
+    return px;
+}
+
+// Rasteriza el frame completo en c->fb (binning + tiles en paralelo).
+static void cpu_raster_frame(CpuRaster* c, const Scene* sc){
+    const int ntiles = c->ntiles, nbands = c->nbands;
+    const bool fill = (c->fill != FILL_NONE);
+    int T = omp_get_max_threads();
+    if (T > c->nthreads) T = c->nthreads;   // el buffer de cursores se dimensiona al inicio
+    if (fill) fill_reserve(c, sc);
+    uint64_t fill_t0 = 0, fill_px = 0;
+
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(T)
+#endif
+    {
+        const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        int* cur = &c->cursor[(size_t)t*ntiles];
+        const int s0 = (int)((long long)sc->num_shapes * t / nt);
+        const int s1 = (int)((long long)sc->num_shapes * (t+1) / nt);
+
+        int* bcur = fill? &c->bcursor[(size_t)t*nbands] : NULL;
+
+        // 1) conteo por tile de las aristas de mis figuras (y con --fill, su tabla de
+        //    aristas de relleno y conteo por banda)
+        memset(cur, 0, sizeof(int)*ntiles);
+        if (fill) memset(bcur, 0, sizeof(int)*nbands);
+        for (int s=s0; s<s1; s++){
+            for (int i=0;i<sc->shapes[s].n;i++){
+                int x0,y0,x1,y1;
+                edge_ends(sc, EDGE_ID(s,i), &x0,&y0,&x1,&y1);
+                bin_edge(c, x0,y0,x1,y1, cur, NULL, 0);
+            }
+            if (fill){ fill_build(c, sc, s); fill_bin(c, s, bcur, NULL); }
+        }
+#ifdef _OPENMP
+        #pragma omp barrier
+        #pragma omp single
+#endif
+        {
+            // 2) prefijo por (tile, hilo)
+            int acc = 0;
+            for (int k=0; k<ntiles; k++){
+                c->start[k] = acc;
+                for (int u=0; u<nt; u++){
+                    int n = c->cursor[(size_t)u*ntiles + k];
+                    c->cursor[(size_t)u*ntiles + k] = acc;
+                    acc += n;
+                }
+            }
+            c->start[ntiles] = acc;
+            if ((size_t)acc > c->refs_cap){
+                free(c->refs);
+                c->refs_cap = (size_t)acc + (size_t)acc/2;
+                c->refs = (uint32_t*)malloc(sizeof(uint32_t)*c->refs_cap);
+                if (!c->refs){ fprintf(stderr,"[ERR] sin memoria (raster refs)\n"); exit(3); }
+            }
+            if (fill){
+                acc = 0;
+                for (int b=0; b<nbands; b++){
+                    c->bstart[b] = acc;
+                    for (int u=0; u<nt; u++){
+                        int n = c->bcursor[(size_t)u*nbands + b];
+                        c->bcursor[(size_t)u*nbands + b] = acc;
+                        acc += n;
+                    }
+                }
+                c->bstart[nbands] = acc;
+                if ((size_t)acc > c->brefs_cap){
+                    free(c->brefs);
+                    c->brefs_cap = (size_t)acc + (size_t)acc/2;
+                    c->brefs = (uint32_t*)malloc(sizeof(uint32_t)*c->brefs_cap);
+                    if (!c->brefs){ fprintf(stderr,"[ERR] sin memoria (relleno)\n"); exit(3); }
+                }
+            }
+        }   // barrera implicita del single
+
+        // 3) llenado (mismo recorrido que el conteo)
+        for (int s=s0; s<s1; s++){
+            for (int i=0;i<sc->shapes[s].n;i++){
+                int x0,y0,x1,y1;
+                uint32_t e = EDGE_ID(s,i);
+                edge_ends(sc, e, &x0,&y0,&x1,&y1);
+                bin_edge(c, x0,y0,x1,y1, cur, c->refs, e);
+            }
+            if (fill) fill_bin(c, s, bcur, c->brefs);
+        }
+#ifdef _OPENMP
+        #pragma omp barrier
+#endif
+        if (fill){
+            // 3b) relleno por bandas: cada banda limpia (o atenua) sus filas completas.
+            //    master no tiene barrera: sin la de abajo otros hilos entrarian al for
+            //    antes de leer fill_t0 y el tiempo de relleno saldria corto
+#ifdef _OPENMP
+            #pragma omp master
+#endif
+            fill_t0 = SDL_GetPerformanceCounter();
+#ifdef _OPENMP
+            #pragma omp barrier
+            #pragma omp for schedule(dynamic,1) reduction(+:fill_px)
+#endif
+            for (int b=0; b<nbands; b++) fill_px += fill_band(c, sc, b);
+#ifdef _OPENMP
+            #pragma omp master
+#endif
+            c->fill_ticks += SDL_GetPerformanceCounter() - fill_t0;
+        }
+#ifdef _OPENMP
+        // 4) raster: cada tile limpia (o atenua) y pinta solo sus pixeles
+        #pragma omp for schedule(dynamic,1)
+#endif
+        for (int k=0; k<ntiles; k++){
+            int cx0, cy0, cx1, cy1;
+            tile_clear(c, k, &cx0, &cy0, &cx1, &cy1);
+            for (int r=c->start[k]; r<c->start[k+1]; r++)
+                raster_edge(c, sc, c->refs[r], cx0,cy0,cx1,cy1);
+        }
+    }
+    if (fill){ c->fill_px += fill_px; c->fill_frames++; }
+}
+
+// Sube el framebuffer a la textura streaming (el present lo hace el llamador).
+static void cpu_upload(SDL_Renderer* R, CpuRaster* c){
+    SDL_UpdateTexture(c->tex, NULL, c->fb.px, c->fb.w*(int)sizeof(uint32_t));
+    SDL_RenderCopy(R, c->tex, NULL, NULL);
+}
+
+static void render_cpu(SDL_Renderer* R, const Scene* sc, CpuRaster* c){
+    cpu_raster_frame(c, sc);
+    cpu_upload(R, c);
+}
+
+// ---------- Frame como grafo de tareas (--frame tasks) ----------
+// Un frame de render cpu como tareas OpenMP con depend en vez de fork/join por
+// etapa: update + binning por bloque de TASK_SHAPES figuras, raster por tile y copia
+// a la textura por fila de tiles. Cada tile depende solo de los bloques cuya caja
+// puede tocarlo, asi un tile arranca en cuanto terminan sus bloques y la copia de
+// una fila se traslapa con el raster de las demas. La caja de cada bloque sale del
+// frame anterior ampliada por su velocidad maxima por eje (un paso de bounce() no
+// la puede dejar). Cada tile pinta sus bloques en orden: mismo resultado que
+// cpu_raster_frame(). depend(iterator) es de OpenMP 5.0 (GCC >= 9, Clang >= 12).
+#define TASK_SHAPES 256
+
+typedef struct {
+    int nb, ntiles;
+    int* bstart;          // nb x (ntiles+1): aristas de cada bloque por tile (CSR)
+    int* bcur;            // nb x ntiles: conteo y luego cursor del llenado
+    uint32_t** brefs;     // por bloque: EDGE_ID ordenados por tile
+    size_t* bcap;
+    int* box;             // nb x 4: tiles tx0,ty0,tx1,ty1 que el bloque puede tocar
+    int* tdeps;           // ntiles x nb: bloques de cada tile en este frame
+    int* ntdeps;
+    char *blk_dep, *tile_dep;   // solo sus direcciones: objetos de depend
+} TaskFrame;
+
+// Caja en tiles de los puntos del bloque b tras un paso mas (mas el pad de AA).
+static void task_block_box(TaskFrame* tf, const Scene* sc, const CpuRaster* c, int b){
+    const int s0 = b*TASK_SHAPES;
+    const int s1 = (s0 + TASK_SHAPES < sc->num_shapes)? s0 + TASK_SHAPES : sc->num_shapes;
+    const bool soa = (sc->layout == LAYOUT_SOA);
+    float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY, vx = 0.f, vy = 0.f;
+    for (size_t q=sc->first[s0]; q<sc->first[s1]; q++){
+        float x = soa? sc->soa.x[q] : sc->pool[q].x, y = soa? sc->soa.y[q] : sc->pool[q].y;
+        float ax = fabsf(soa? sc->soa.vx[q] : sc->pool[q].vx);
+        float ay = fabsf(soa? sc->soa.vy[q] : sc->pool[q].vy);
+        x0 = x < x0? x : x0; x1 = x > x1? x : x1;
+        y0 = y < y0? y : y0; y1 = y > y1? y : y1;
+        vx = ax > vx? ax : vx; vy = ay > vy? ay : vy;
+    }
+    int* bx = &tf->box[4*b];
+    const int m = 1 + c->pad;   // las lineas AA pintan hasta pad px fuera de los puntos
+    bx[0] = clampi((int)floorf(x0 - vx) - m, 0, c->fb.w-1) / TILE;
+    bx[1] = clampi((int)floorf(y0 - vy) - m, 0, c->fb.h-1) / TILE;
+    bx[2] = clampi((int)floorf(x1 + vx) + m, 0, c->fb.w-1) / TILE;
+    bx[3] = clampi((int)floorf(y1 + vy) + m, 0, c->fb.h-1) / TILE;
+}
+
+static void task_frame_init(TaskFrame* tf, const Scene* sc, const CpuRaster* c){
+    memset(tf, 0, sizeof(*tf));
+    tf->nb = (sc->num_shapes + TASK_SHAPES - 1) / TASK_SHAPES;
+    tf->ntiles = c->ntiles;
+    const size_t nb = (size_t)tf->nb, nt = (size_t)tf->ntiles;
+    tf->bstart = (int*)malloc(sizeof(int)*nb*(nt+1));
+    tf->bcur = (int*)malloc(sizeof(int)*nb*nt);
+    tf->brefs = (uint32_t**)calloc(nb, sizeof(uint32_t*));
+    tf->bcap = (size_t*)calloc(nb, sizeof(size_t));
+    tf->box = (int*)malloc(sizeof(int)*4*nb);
+    tf->tdeps = (int*)malloc(sizeof(int)*nt*nb);
+    tf->ntdeps = (int*)malloc(sizeof(int)*nt);
+    tf->blk_dep = (char*)malloc(nb);
+    tf->tile_dep = (char*)malloc(nt);
+    if (!tf->bstart || !tf->bcur || !tf->brefs || !tf->bcap || !tf->box || !tf->tdeps ||
+        !tf->ntdeps || !tf->blk_dep || !tf->tile_dep){
+        fprintf(stderr,"[ERR] sin memoria (grafo de tareas)\n"); exit(3);
+    }
+    for (int b=0; b<tf->nb; b++) task_block_box(tf, sc, c, b);
+}
+
+static void task_frame_free(TaskFrame* tf){
+    for (int b=0; b<tf->nb; b++) free(tf->brefs[b]);
+    free(tf->bstart); free(tf->bcur); free(tf->brefs); free(tf->bcap); free(tf->box);
+    free(tf->tdeps); free(tf->ntdeps); free(tf->blk_dep); free(tf->tile_dep);
+    memset(tf, 0, sizeof(*tf));
+}
+
+// Tarea: un paso de las figuras del bloque b, su caja del proximo frame y el
+// binning de sus aristas (mismo recorrido que cpu_raster_frame, local al bloque).
+static void task_update_block(TaskFrame* tf, Scene* sc, const CpuRaster* c, int b, int w, int h){
+    uint64_t tt = trace_begin();
+    const int nt = tf->ntiles;
+    const int s0 = b*TASK_SHAPES;
+    const int s1 = (s0 + TASK_SHAPES < sc->num_shapes)? s0 + TASK_SHAPES : sc->num_shapes;
+    const size_t k0 = sc->first[s0], k1 = sc->first[s1];
+    if (sc->layout == LAYOUT_SOA) bounce_soa(&sc->soa, &sc->soa, k0, k1-k0, (float)w, (float)h);
+    else for (size_t q=k0; q<k1; q++) bounce(&sc->pool[q], w, h);
+    task_block_box(tf, sc, c, b);
+
+    int* st = &tf->bstart[(size_t)b*(nt+1)];
+    int* cur = &tf->bcur[(size_t)b*nt];
+    memset(cur, 0, sizeof(int)*nt);
+    for (int s=s0; s<s1; s++){
+        for (int i=0;i<sc->shapes[s].n;i++){
+            int x0,y0,x1,y1;
+            edge_ends(sc, EDGE_ID(s,i), &x0,&y0,&x1,&y1);
+            bin_edge(c, x0,y0,x1,y1, cur, NULL, 0);
+        }
+    }
+    int acc = 0;
+    for (int k=0; k<nt; k++){ st[k] = acc; acc += cur[k]; cur[k] = st[k]; }
+    st[nt] = acc;
+    if ((size_t)acc > tf->bcap[b]){
+        free(tf->brefs[b]);
+        tf->bcap[b] = (size_t)acc + (size_t)acc/2;
+        tf->brefs[b] = (uint32_t*)malloc(sizeof(uint32_t)*tf->bcap[b]);
+        if (!tf->brefs[b]){ fprintf(stderr,"[ERR] sin memoria (grafo de tareas)\n"); exit(3); }
+    }
+    for (int s=s0; s<s1; s++){
+        for (int i=0;i<sc->shapes[s].n;i++){
+            int x0,y0,x1,y1;
+            uint32_t e = EDGE_ID(s,i);
+            edge_ends(sc, e, &x0,&y0,&x1,&y1);
+            bin_edge(c, x0,y0,x1,y1, cur, tf->brefs[b], e);
+        }
+    }
+    trace_end(TR_UPDATE, tt, (uint32_t)(s1 - s0));
+}
+
+// Tarea: tile k con las aristas de sus bloques, en orden de bloque (= de figura).
+static void task_raster_tile(const TaskFrame* tf, const Scene* sc, CpuRaster* c, int k){
+    uint64_t tt = trace_begin();
+    int cx0, cy0, cx1, cy1;
+    tile_clear(c, k, &cx0, &cy0, &cx1, &cy1);
+    for (int j=0; j<tf->ntdeps[k]; j++){
+        const int b = tf->tdeps[(size_t)k*tf->nb + j];
+        const int* st = &tf->bstart[(size_t)b*(tf->ntiles+1)];
+        for (int r=st[k]; r<st[k+1]; r++)
+            raster_edge(c, sc, tf->brefs[b][r], cx0,cy0,cx1,cy1);
+    }
+    trace_end(TR_RASTER, tt, (uint32_t)tf->ntdeps[k]);
+}
+
+// Tarea: copia la fila de tiles r a la textura bloqueada.
+static void task_upload_row(const CpuRaster* c, int r, void* pixels, int pitch){
+    uint64_t tt = trace_begin();
+    const int y1 = (r+1)*TILE < c->fb.h? (r+1)*TILE : c->fb.h;
+    for (int y=r*TILE; y<y1; y++)
+        memcpy((char*)pixels + (size_t)y*pitch, &c->fb.px[(size_t)y*c->fb.w], sizeof(uint32_t)*c->fb.w);
+    trace_end(TR_UPLOAD, tt, (uint32_t)r);
+}
+
+static void task_frame(TaskFrame* tf, Scene* sc, CpuRaster* c, SDL_Renderer* R, const Args* a){
+    const int nb = tf->nb, ntiles = tf->ntiles, tx = c->tiles_x, ty = c->tiles_y;
+    // Dependencias de este frame con las cajas que dejo el anterior
+    memset(tf->ntdeps, 0, sizeof(int)*ntiles);
+    for (int b=0; b<nb; b++){
+        const int* bx = &tf->box[4*b];
+        for (int y=bx[1]; y<=bx[3]; y++)
+            for (int x=bx[0]; x<=bx[2]; x++){
+                int k = y*tx + x;
+                tf->tdeps[(size_t)k*nb + tf->ntdeps[k]++] = b;
+            }
+    }
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(c->tex, NULL, &pixels, &pitch) != 0){
+        fprintf(stderr,"[ERR] SDL_LockTexture: %s\n", SDL_GetError()); exit(1);
+    }
+    char* bd = tf->blk_dep;
+    char* td = tf->tile_dep;
+#ifdef _OPENMP
+    #pragma omp parallel if(a->mode == MODE_OMP)
+    #pragma omp single
+#endif
+    {
+        for (int b=0; b<nb; b++){
+#ifdef _OPENMP
+            #pragma omp task depend(out: bd[b])
+#endif
+            task_update_block(tf, sc, c, b, a->winW, a->winH);
+        }
+        for (int k=0; k<ntiles; k++){
+            const int* deps = &tf->tdeps[(size_t)k*nb];
+#ifdef _OPENMP
+            #pragma omp task depend(iterator(j=0:tf->ntdeps[k]), in: bd[deps[j]]) depend(out: td[k])
+#else
+            (void)deps;
+#endif
+            task_raster_tile(tf, sc, c, k);
+        }
+        for (int r=0; r<ty; r++){
+#ifdef _OPENMP
+            #pragma omp task depend(iterator(j=0:tx), in: td[r*tx + j])
+#endif
+            task_upload_row(c, r, pixels, pitch);
+        }
+    }   // fin del single: todas las tareas terminaron
+    (void)bd; (void)td;
+    SDL_UnlockTexture(c->tex);
+    SDL_RenderCopy(R, c->tex, NULL, NULL);
+}
+
+// ---------- Loop principal ----------
+static double now_ms(void){
+    // Contador de alta resolucion: SDL_GetTicks (1 ms) no alcanza para medir el render.
+    return (double)SDL_GetPerformanceCounter() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static const char* render_name(RenderPath r){
+    return (r==RENDER_CPU)? "cpu" : (r==RENDER_GEOM)? "geom" : (r==RENDER_BATCH)? "batch" : "legacy";
+}
+
+static const char* sched_name(SchedKind k){
+    return (k==SCHED_DYNAMIC)? "dynamic" : (k==SCHED_GUIDED)? "guided" : "static";
+}
+
+static const char* mode_name(RunMode m){ return (m==MODE_POOL)? "POOL" : (m==MODE_OMP)? "OMP" : "SEQ"; }
+static const char* loop_name(LoopKind l){ return (l==LOOP_POINT)? "point" : "shape"; }
+static const char* frame_name(FrameKind f){ return (f==FRAME_TASKS)? "tasks" : "fork"; }
+static const char* sim_name(SimKind k){ return (k==SIM_ANALYTIC)? "analytic" : "step"; }
+static const char* fill_name(FillRule f){
+    static const char* names[] = { "none", "evenodd", "nonzero" };
+    return names[f];
+}
+static const char* collide_name(CollideKind c){
+    static const char* names[] = { "none", "points", "shapes" };
+    return names[c];
+}
+
+static const char* trail_name(const Args* a){
+    return (a->trail == 0)? "none" : (a->trail_mode==TRAIL_DECAY)? "decay" : "history";
+}
+
+// "fixed", "uniform:A-B" o "zipf:S" (buffer estatico; solo para imprimir).
+static const char* dist_name(const Args* a){
+    static char buf[32];
+    if (a->dist == DIST_UNIFORM) snprintf(buf, sizeof(buf), "uniform:%d-%d", a->dist_min, a->dist_max);
+    else if (a->dist == DIST_ZIPF) snprintf(buf, sizeof(buf), "zipf:%g", a->zipf_s);
+    else snprintf(buf, sizeof(buf), "fixed");
+    return buf;
+}
+
+// Muestras por frame (ms), despues del warmup. Crece por duplicacion.
+typedef struct {
+    double *total, *update, *render, *present, *hidden;
+    int n, cap;
+} FrameSamples;
+
+static void samples_push(FrameSamples* fs, double total, double update, double render_ms,
+                         double present, double hidden){
+    if (fs->n == fs->cap){
+        int cap = fs->cap? fs->cap*2 : 1024;
+        double** cols[5] = { &fs->total, &fs->update, &fs->render, &fs->present, &fs->hidden };
+        for (int c=0; c<5; c++){
+            double* p = (double*)realloc(*cols[c], sizeof(double)*cap);
+            if (!p){ fprintf(stderr,"[ERR] sin memoria (samples)\n"); exit(3); }
+            *cols[c] = p;
+        }
+        fs->cap = cap;
+    }
+    fs->total[fs->n] = total;     fs->update[fs->n] = update;
+    fs->render[fs->n] = render_ms; fs->present[fs->n] = present;
+    fs->hidden[fs->n] = hidden;
+    fs->n++;
+}
+
+static void samples_append(FrameSamples* dst, const FrameSamples* src){
+    for (int k=0; k<src->n; k++)
+        samples_push(dst, src->total[k], src->update[k], src->render[k], src->present[k], src->hidden[k]);
+}
+
+static void samples_free(FrameSamples* fs){
+    free(fs->total); free(fs->update); free(fs->render); free(fs->present); free(fs->hidden);
+    memset(fs, 0, sizeof(*fs));
+}
+
+// Resumen de una o varias corridas.
+typedef struct {
+    double avg_ms;          // ms por frame (update + render + present)
+    double avg_update_ms;   // ms por frame en update (en pipeline: trabajo de bloques / hilos)
+    double avg_render_ms;   // ms por frame solo en render
+    double avg_present_ms;  // ms por frame en SDL_RenderPresent
+    double p50_ms, p95_ms, p99_ms, stddev_ms;   // del tiempo total por frame
+    double hidden_pct;      // pipeline: % del update que quedo oculto detras del render
+    int frames;
+    uint64_t checksum;      // scene_checksum() del estado final (de la ultima corrida)
+    double arena_bytes;     // tamaño de la arena de la escena
+    double update_bytes;    // bytes leidos + escritos por frame en update (x,y,vx,vy ida y vuelta)
+    double sim_steps_s;     // pasos de simulacion por segundo de pared
+    double render_fps;      // frames dibujados por segundo de pared (incluye warmup)
+    double collide_ms;      // ms por paso en choques (grid + resolucion), ya incluido en update
+    double contacts;        // pares en contacto por paso
+    double fill_ms;         // --fill: ms por frame en la pasada de bandas (incluido en render)
+    double fill_mpx;        // --fill: millones de pixeles rellenados por frame
+} RunStats;
+
+// GB/s efectivos del update; comparar con el ancho de banda de memoria de la maquina.
+static double update_gbs(const RunStats* st){
+    return (st->avg_update_ms > 0.0)? st->update_bytes / (st->avg_update_ms * 1e6) : 0.0;
+}
+
+static int cmp_double(const void* x, const void* y){
+    double a = *(const double*)x, b = *(const double*)y;
+    return (a > b) - (a < b);
+}
+
+// Percentil por rango mas cercano sobre un arreglo ordenado.
+static double percentile(const double* sorted, int n, double p){
+    if (n <= 0) return 0.0;
+    int k = (int)ceil(p/100.0 * n) - 1;
+    return sorted[k<0? 0 : (k>=n? n-1 : k)];
+}
+
+static RunStats summarize(const FrameSamples* fs){
+    RunStats st;
+    memset(&st, 0, sizeof(st));
+    st.frames = fs->n;
+    if (fs->n == 0) return st;
+    double su=0, sr=0, sp=0, sh=0, st_=0;
+    for (int k=0; k<fs->n; k++){
+        st_ += fs->total[k]; su += fs->update[k]; sr += fs->render[k];
+        sp += fs->present[k]; sh += fs->hidden[k];
+    }
+    st.avg_ms = st_/fs->n;
+    st.avg_update_ms = su/fs->n;
+    st.avg_render_ms = sr/fs->n;
+    st.avg_present_ms = sp/fs->n;
+    st.hidden_pct = (su>0.0)? (100.0*sh/su) : 0.0;
+    double var = 0.0;
+    for (int k=0; k<fs->n; k++){ double d = fs->total[k]-st.avg_ms; var += d*d; }
+    st.stddev_ms = (fs->n>1)? sqrt(var/(fs->n-1)) : 0.0;
+    double* sorted = (double*)malloc(sizeof(double)*fs->n);
+    if (!sorted){ fprintf(stderr,"[ERR] sin memoria (percentiles)\n"); exit(3); }
+    memcpy(sorted, fs->total, sizeof(double)*fs->n);
+    qsort(sorted, fs->n, sizeof(double), cmp_double);
+    st.p50_ms = percentile(sorted, fs->n, 50.0);
+    st.p95_ms = percentile(sorted, fs->n, 95.0);
+    st.p99_ms = percentile(sorted, fs->n, 99.0);
+    free(sorted);
+    return st;
+}
+
+// Costo del relleno acumulado en el raster, por frame dibujado.
+static void fill_stats(const CpuRaster* c, double* ms, double* mpx){
+    const double n = c->fill_frames? (double)c->fill_frames : 1.0;
+    *ms = (double)c->fill_ticks * 1000.0 / (double)SDL_GetPerformanceFrequency() / n;
+    *mpx = (double)c->fill_px / 1e6 / n;
+}
+
+static void print_fill(const Args* a, double ms, double mpx){
+    printf("[FILL] %s alpha %d | bandas %.3f ms/frame | %.2f Mpx/frame | %.1f Mpx/s\n",
+           fill_name(a->fill), a->fill_alpha, ms, mpx, (ms > 0.0)? mpx*1000.0/ms : 0.0);
+}
+
+// trail->len == 0 => sin historial (o estela por decay dentro del raster cpu).
+static void render_frame(SDL_Renderer* R, const Scene* sc, const Args* a, RenderBatch* batch,
+                         CpuRaster* raster, TrailHist* trail){
+    if (a->render == RENDER_CPU){ render_cpu(R, sc, raster); return; }
+    // Fondo oscuro
+    SDL_SetRenderDrawColor(R, 3,3,6,255);
+    SDL_RenderClear(R);
+    if (trail->len){
+        trail_draw(R, sc, trail, batch->order);
+        trail_push(trail, sc);
+    }
+    if (a->render == RENDER_LEGACY) render(R, sc);
+    else                            render_batched(R, sc, batch, a->render);
+}
+
+// Un frame del pipeline: el hilo maestro (el de SDL) dibuja y presenta front
+// mientras el resto calcula back = paso(front) por bloques; al terminar el maestro
+// se suma a los bloques que queden (schedule dynamic). La barrera implicita del
+// for es el limite de frame: despues el llamador intercambia front y back.
+// Con render cpu el raster anidado corre en un solo hilo (sin paralelismo anidado).
+static void pipeline_frame(SDL_Renderer* R, const Scene* front, Scene* back, const Args* a,
+                           RenderBatch* batch, CpuRaster* raster, TrailHist* trail,
+                           double* render_ms, double* present_ms, double* update_ms){
+    const int nb = scene_nblocks(front);
+    double t_render = 0.0, t_present = 0.0, upd_work = 0.0;
+    int nt = 1;
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+#ifdef _OPENMP
+        #pragma omp master
+#endif
+        {
+            nt = omp_get_num_threads();
+            double tr = now_ms();
+            uint64_t tt = trace_begin();
+            render_frame(R, front, a, batch, raster, trail);
+            tt = trace_end(TR_RENDER, tt, 0);
+            double tp = now_ms();
+            SDL_RenderPresent(R);
+            trace_end(TR_PRESENT, tt, 0);
+            t_render = tp - tr;
+            t_present = now_ms() - tp;
+        }
+        uint64_t tw = trace_begin();
+        uint32_t it = 0;
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic,1) reduction(+:upd_work) nowait
+#endif
+        for (int b=0; b<nb; b++){
+            double tb = now_ms();
+            scene_step_block(front, back, b, a->winW, a->winH);
+            upd_work += now_ms() - tb;
+            it++;
+        }
+        uint64_t tb = trace_end(TR_UPDATE, tw, it);
+#ifdef _OPENMP
+        #pragma omp barrier
+#endif
+        trace_end(TR_BARRIER, tb, 0);
+    }
+    *render_ms = t_render;
+    *present_ms = t_present;
+    // Costo del update si corriera solo con todo el equipo de hilos
+    *update_ms = upd_work / (double)nt;
+}
+
+// ---------- Colisiones (grid uniforme) ----------
+// Cada update se reconstruye un grid de celdas de lado >= 2r con counting sort:
+// histograma por hilo sobre su rango de puntos, prefijo (celda, hilo) y scatter
+// estable, asi el orden dentro de cada celda es el orden plano sin importar los
+// hilos. Posiciones y velocidades se copian en ese orden (vecinos contiguos en
+// memoria) y cada punto revisa las 3x3 celdas vecinas: choque elastico entre masas
+// iguales contra cada vecino que se acerca (promediado si son varios, conservando
+// la rapidez del punto). Cada hilo escribe solo las velocidades de
+// los puntos de sus celdas, leyendo las copias, sin locks y con el mismo resultado
+// para cualquier numero de hilos. Costo O(puntos) mientras la densidad se mantenga.
+#define GRID_MAX_BINS (1 << 24)   // celdas x hilos del histograma
+
+typedef struct {
+    CollideKind kind;
+    float r;
+    float inv_cell;          // 1 / lado de celda
+    int gw, gh, ncells, nt;
+    size_t total;
+    uint32_t* cell_of;       // celda de cada punto (orden plano)
+    uint32_t* start;         // ncells+1: rango de cada celda en el orden del grid
+    uint32_t* hist;          // nt x ncells: conteo y luego posicion de escritura
+    uint32_t* idx;           // punto plano de cada posicion del grid
+    uint32_t* owner;         // figura de cada punto (solo --collide shapes)
+    float *sx, *sy, *svx, *svy;   // copias en orden del grid
+    uint32_t* sown;          // owner en orden del grid
+    double build_ms, solve_ms;
+    long contacts;           // pares en contacto, acumulado
+    long steps;
+} Collider;
+
+static void collide_init(Collider* c, const Scene* sc, const Args* a){
+    memset(c, 0, sizeof(*c));
+    c->kind = a->collide;
+    c->r = (float)a->radius;
+    c->total = sc->total;
+    c->nt = (a->mode != MODE_SEQ)? omp_get_max_threads() : 1;
+    // Celdas mas grandes si el histograma por hilo no entra en GRID_MAX_BINS
+    float cell = 2.0f * c->r;
+    for (;;){
+        c->gw = (int)((float)a->winW / cell) + 1;
+        c->gh = (int)((float)a->winH / cell) + 1;
+        if ((long)c->gw * c->gh * c->nt <= GRID_MAX_BINS) break;
+        cell *= 1.5f;
+    }
+    c->inv_cell = 1.0f / cell;
+    c->ncells = c->gw * c->gh;
+    const size_t n = sc->total;
+    c->cell_of = (uint32_t*)aligned_alloc64(sizeof(uint32_t)*n);
+    c->idx     = (uint32_t*)aligned_alloc64(sizeof(uint32_t)*n);
+    c->start   = (uint32_t*)aligned_alloc64(sizeof(uint32_t)*((size_t)c->ncells + 1));
+    c->hist    = (uint32_t*)aligned_alloc64(sizeof(uint32_t)*(size_t)c->ncells*c->nt);
+    c->sx  = (float*)aligned_alloc64(sizeof(float)*n);
+    c->sy  = (float*)aligned_alloc64(sizeof(float)*n);
+    c->svx = (float*)aligned_alloc64(sizeof(float)*n);
+    c->svy = (float*)aligned_alloc64(sizeof(float)*n);
+    if (c->kind == COLLIDE_SHAPES){
+        c->owner = (uint32_t*)aligned_alloc64(sizeof(uint32_t)*n);
+        c->sown  = (uint32_t*)aligned_alloc64(sizeof(uint32_t)*n);
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static) if(a->mode != MODE_SEQ)
+#endif
+        for (int s=0; s<sc->num_shapes; s++){
+            for (size_t k=sc->first[s]; k<sc->first[s+1]; k++) c->owner[k] = (uint32_t)s;
+        }
+    }
+}
+
+static void collide_free(Collider* c){
+    void* bufs[] = { c->cell_of, c->idx, c->start, c->hist, c->sx, c->sy, c->svx, c->svy,
+                     c->owner, c->sown };
+    for (size_t k=0; k<sizeof(bufs)/sizeof(bufs[0]); k++) if (bufs[k]) aligned_free64(bufs[k]);
+    memset(c, 0, sizeof(*c));
+}
+
+// Rango [k0,k1) de puntos del hilo t de nt (particion fija, como schedule(static)).
+static inline void collide_chunk(size_t n, int t, int nt, size_t* k0, size_t* k1){
+    *k0 = n * (size_t)t / (size_t)nt;
+    *k1 = n * (size_t)(t+1) / (size_t)nt;
+}
+
+// Reconstruye el grid y ajusta las velocidades de los puntos en contacto.
+static void scene_collide(Collider* c, Scene* sc, RunMode mode){
+    const size_t n = c->total;
+    const bool soa = (sc->layout == LAYOUT_SOA);
+    const int gw = c->gw, gh = c->gh, nc = c->ncells;
+    const float inv = c->inv_cell;
+    uint64_t tt = trace_begin();
+    double t0 = now_ms();
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(c->nt) if(mode != MODE_SEQ)
+#else
+    (void)mode;
+#endif
+    {
+        const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        size_t k0, k1;
+        collide_chunk(n, t, nt, &k0, &k1);
+        uint32_t* h = c->hist + (size_t)t*nc;
+        memset(h, 0, sizeof(uint32_t)*nc);
+        for (size_t k=k0; k<k1; k++){
+            float x = soa? sc->soa.x[k] : sc->pool[k].x;
+            float y = soa? sc->soa.y[k] : sc->pool[k].y;
+            int cx = (int)(x * inv), cy = (int)(y * inv);
+            cx = cx < 0? 0 : (cx >= gw? gw-1 : cx);
+            cy = cy < 0? 0 : (cy >= gh? gh-1 : cy);
+            uint32_t cell = (uint32_t)(cy*gw + cx);
+            c->cell_of[k] = cell;
+            h[cell]++;
+        }
+#ifdef _OPENMP
+        #pragma omp barrier
+        #pragma omp single
+#endif
+        {
+            // Prefijo en orden (celda, hilo): dentro de una celda van primero los
+            // puntos del hilo 0, que son los de menor indice plano
+            uint32_t sum = 0;
+            for (int cell=0; cell<nc; cell++){
+                c->start[cell] = sum;
+                for (int q=0; q<nt; q++){
+                    uint32_t cnt = c->hist[(size_t)q*nc + cell];
+                    c->hist[(size_t)q*nc + cell] = sum;
+                    sum += cnt;
+                }
+            }
+            c->start[nc] = sum;
+        }
+        for (size_t k=k0; k<k1; k++) c->idx[h[c->cell_of[k]]++] = (uint32_t)k;
+#ifdef _OPENMP
+        #pragma omp barrier
+        #pragma omp for schedule(static)
+#endif
+        for (long i=0; i<(long)n; i++){
+            uint32_t k = c->idx[i];
+            if (soa){ c->sx[i] = sc->soa.x[k]; c->sy[i] = sc->soa.y[k];
+                      c->svx[i] = sc->soa.vx[k]; c->svy[i] = sc->soa.vy[k]; }
+            else    { c->sx[i] = sc->pool[k].x; c->sy[i] = sc->pool[k].y;
+                      c->svx[i] = sc->pool[k].vx; c->svy[i] = sc->pool[k].vy; }
+            if (c->sown) c->sown[i] = c->owner[k];
+        }
+    }
+    double t1 = now_ms();
+
+    const float d2max = 4.0f * c->r * c->r;
+    long contacts = 0;
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(c->nt) schedule(dynamic,64) reduction(+:contacts) if(mode != MODE_SEQ)
+#endif
+    for (int cell=0; cell<nc; cell++){
+        const int cx = cell % gw, cy = cell / gw;
+        const int x0 = cx > 0? cx-1 : 0, x1 = cx < gw-1? cx+1 : gw-1;
+        const int y0 = cy > 0? cy-1 : 0, y1 = cy < gh-1? cy+1 : gh-1;
+        for (uint32_t i=c->start[cell]; i<c->start[cell+1]; i++){
+            const float xi = c->sx[i], yi = c->sy[i], vxi = c->svx[i], vyi = c->svy[i];
+            float dvx = 0.f, dvy = 0.f;
+            int hits = 0;
+            for (int ny=y0; ny<=y1; ny++){
+                // Las celdas vecinas de una fila son contiguas en el orden del grid
+                const uint32_t j0 = c->start[ny*gw + x0], j1 = c->start[ny*gw + x1 + 1];
+                for (uint32_t j=j0; j<j1; j++){
+                    if (j == i || (c->sown && c->sown[j] == c->sown[i])) continue;
+                    float dx = c->sx[j] - xi, dy = c->sy[j] - yi;
+                    float d2 = dx*dx + dy*dy;
+                    if (d2 >= d2max || d2 == 0.f) continue;
+                    // (vj - vi).d < 0: se acercan; intercambio de la componente normal
+                    float vn = (c->svx[j] - vxi)*dx + (c->svy[j] - vyi)*dy;
+                    if (vn >= 0.f) continue;
+                    dvx += vn / d2 * dx;
+                    dvy += vn / d2 * dy;
+                    hits++;
+                    if (j > i) contacts++;
+                }
+            }
+            if (hits){
+                // Promedio de los impulsos y misma rapidez que antes: con muchos
+                // contactos a la vez la suma sola inyecta energia y todo termina
+                // apilado contra los bordes
+                float nvx = vxi + dvx / (float)hits, nvy = vyi + dvy / (float)hits;
+                float v2 = nvx*nvx + nvy*nvy;
+                if (v2 > 0.f){
+                    float k2 = sqrtf((vxi*vxi + vyi*vyi) / v2);
+                    nvx *= k2; nvy *= k2;
+                }
+                uint32_t k = c->idx[i];
+                if (soa){ sc->soa.vx[k] = nvx; sc->soa.vy[k] = nvy; }
+                else    { sc->pool[k].vx = nvx; sc->pool[k].vy = nvy; }
+            }
+        }
+    }
+    double t2 = now_ms();
+    c->build_ms += t1 - t0;
+    c->solve_ms += t2 - t1;
+    c->contacts += contacts;
+    c->steps++;
+    trace_end(TR_COLLIDE, tt, (uint32_t)contacts);
+}
+
+// ---------- Paso fijo ----------
+// La simulacion avanza en pasos de tick_ms de tiempo real acumulado; el render dibuja
+// una vista interpolada entre el estado anterior al ultimo paso y el actual.
+// Mas de MAX_SUBSTEPS pasos pendientes en un frame se descartan (si no, un render
+// lento pediria cada vez mas pasos y nunca se recuperaria).
+#define MAX_SUBSTEPS 16
+
+typedef struct {
+    double tick_ms;     // 1000 / --tick
+    double acc_ms;      // tiempo real aun no simulado
+    double last_ms;     // now_ms() del frame anterior
+    float *px, *py;     // posiciones antes del ultimo paso, orden plano de first[]
+    Scene view;         // lo que se dibuja: mezcla de px/py con el estado actual
+    long steps, dropped;
+} FixedStep;
+
+static void fixed_init(FixedStep* fx, const Scene* sc, const Args* a){
+    memset(fx, 0, sizeof(*fx));
+    fx->tick_ms = 1000.0 / (double)a->tick_hz;
+    fx->px = (float*)aligned_alloc64(sizeof(float)*sc->total);
+    fx->py = (float*)aligned_alloc64(sizeof(float)*sc->total);
+    scene_clone(&fx->view, sc, a->loop);
+    for (size_t k=0; k<sc->total; k++){
+        fx->px[k] = (sc->layout == LAYOUT_SOA)? sc->soa.x[k] : sc->pool[k].x;
+        fx->py[k] = (sc->layout == LAYOUT_SOA)? sc->soa.y[k] : sc->pool[k].y;
+    }
+    fx->last_ms = now_ms();
+}
+
+static void fixed_free(FixedStep* fx){
+    if (fx->px) aligned_free64(fx->px);
+    if (fx->py) aligned_free64(fx->py);
+    if (fx->view.arena) scene_free(&fx->view);
+    memset(fx, 0, sizeof(*fx));
+}
+
+// n pasos seguidos sobre [k0,k1) mientras el rango esta en cache (mismo resultado
+// que n updates completos: cada punto es independiente); antes del ultimo guarda
+// las posiciones para interpolar.
+static inline void fixed_save_range(FixedStep* fx, const Scene* sc, size_t k0, size_t k1){
+    for (size_t q=k0; q<k1; q++){
+        fx->px[q] = (sc->layout == LAYOUT_SOA)? sc->soa.x[q] : sc->pool[q].x;
+        fx->py[q] = (sc->layout == LAYOUT_SOA)? sc->soa.y[q] : sc->pool[q].y;
+    }
+}
+
+static void fixed_step_range(Scene* sc, FixedStep* fx, size_t k0, size_t k1, int n, int w, int h){
+    for (int k=0; k<n; k++){
+        if (k == n-1) fixed_save_range(fx, sc, k0, k1);
+        if (sc->layout == LAYOUT_SOA) bounce_soa(&sc->soa, &sc->soa, k0, k1-k0, (float)w, (float)h);
+        else for (size_t q=k0; q<k1; q++) bounce(&sc->pool[q], w, h);
+    }
+}
+
+// --mode pool: los mismos pasos fusionados sobre un rango de unidades del pool.
+typedef struct { Scene* sc; FixedStep* fx; LoopKind loop; int n, w, h; } FixedPoolStep;
+
+static void fixed_pool_units(void* ctx, long u0, long u1){
+    const FixedPoolStep* fp = (const FixedPoolStep*)ctx;
+    size_t k0, k1, e0, e1;
+    scene_unit_range(fp->sc, fp->loop, u0, &k0, &e0);
+    scene_unit_range(fp->sc, fp->loop, u1-1, &e1, &k1);
+    (void)e0; (void)e1;
+    fixed_step_range(fp->sc, fp->fx, k0, k1, fp->n, fp->w, fp->h);
+}
+
+// Consume el acumulador: devuelve los pasos dados en este frame. Con choques (col)
+// los pasos van completos uno a uno: el grid acopla puntos de distintos bloques.
+static int fixed_advance(FixedStep* fx, Scene* sc, const Args* a, Collider* col){
+    double now = now_ms();
+    fx->acc_ms += now - fx->last_ms;
+    fx->last_ms = now;
+    int n = (int)(fx->acc_ms / fx->tick_ms);
+    if (n > MAX_SUBSTEPS){
+        fx->dropped += n - MAX_SUBSTEPS;
+        fx->acc_ms -= (double)(n - MAX_SUBSTEPS) * fx->tick_ms;
+        n = MAX_SUBSTEPS;
+    }
+    if (n > 0 && col){
+        for (int k=0; k<n; k++){
+            if (k == n-1) fixed_save_range(fx, sc, 0, sc->total);
+            scene_update(sc, a->mode, a->loop, a->winW, a->winH);
+            scene_collide(col, sc, a->mode);
+        }
+    } else if (n > 0 && a->mode == MODE_POOL){
+        FixedPoolStep fs = { sc, fx, a->loop, n, a->winW, a->winH };
+        tpool_run(&g_tpool, scene_units(sc, a->loop), fixed_pool_units, &fs);
+    } else if (n > 0){
+        const long units = scene_units(sc, a->loop);
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(runtime) if(a->mode == MODE_OMP)
+#endif
+        for (long u=0; u<units; u++){
+            size_t k0, k1;
+            scene_unit_range(sc, a->loop, u, &k0, &k1);
+            fixed_step_range(sc, fx, k0, k1, n, a->winW, a->winH);
+        }
+    }
+    fx->acc_ms -= (double)n * fx->tick_ms;
+    fx->steps += n;
+    return n;
+}
+
+// view = prev + alpha*(actual - prev), alpha = fraccion de paso aun no simulada.
+static void fixed_interp(FixedStep* fx, const Scene* sc, const Args* a){
+    const float alpha = (float)(fx->acc_ms / fx->tick_ms);
+    const long total = (long)sc->total;
+    Scene* v = &fx->view;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if(a->mode != MODE_SEQ)
+#else
+    (void)a;
+#endif
+    for (long k=0; k<total; k++){
+        float cx = (sc->layout == LAYOUT_SOA)? sc->soa.x[k] : sc->pool[k].x;
+        float cy = (sc->layout == LAYOUT_SOA)? sc->soa.y[k] : sc->pool[k].y;
+        float x = fx->px[k] + alpha*(cx - fx->px[k]);
+        float y = fx->py[k] + alpha*(cy - fx->py[k]);
+        if (v->layout == LAYOUT_SOA){ v->soa.x[k] = x; v->soa.y[k] = y; }
+        else                        { v->pool[k].x = x; v->pool[k].y = y; }
+    }
+}
+
+// Espera hasta deadline (en ms de now_ms). SDL_Delay tiene granularidad de 1 ms o
+// peor: duerme con el hasta ~2 ms antes, despues en pasos de a lo sumo 1 ms (nanosleep
+// en POSIX) hasta que queden WAIT_SPIN_MS, y solo eso es espera activa (con pause).
+// Girar los 2 ms completos costaba ~12% de un nucleo a 60 FPS en el hilo principal.
+#define WAIT_SPIN_MS 0.2
+static void wait_until(double deadline){
+    double left = deadline - now_ms();
+    if (left > 2.0) SDL_Delay((Uint32)(left - 2.0));
+    while ((left = deadline - now_ms()) > WAIT_SPIN_MS){
+#if defined(__unix__) || defined(__APPLE__)
+        const double ms = (left - WAIT_SPIN_MS < 1.0)? left - WAIT_SPIN_MS : 1.0;
+        struct timespec ts = { 0, (long)(ms * 1e6) };
+        nanosleep(&ts, NULL);
+#else
+        if (left < 1.0 + WAIT_SPIN_MS) break;   // SDL_Delay(1) puede pasarse: el resto gira
+        SDL_Delay(1);
+#endif
+    }
+    while (now_ms() < deadline) tpool_relax();
+}
+
+// ---------- Memoria compartida (--shm) ----------
+// Segmento POSIX con las posiciones de cada frame para front-ends externos (p. ej.
+// Screen.py --shm): se mapea y se lee sin copias ni serializacion. Formato:
+//   ShmHeader (128 bytes) | ShmShape[num_shapes] | xy[0] | xy[1]
+// con xy[b] = float32 (x,y) intercalados en el orden plano de first[], cada bloque
+// alineado a 64 bytes. Doble buffer versionado: el frame f se escribe en xy[f & 1]
+// con seq[b] impar mientras se escribe y par al terminar, y luego frame = f+1. El
+// lector toma b = (frame-1) & 1, usa xy[b] directo y confirma con seq[b] sin cambios
+// que el productor no lo piso mientras tanto (tiene un frame entero de margen).
+#define SHM_VERSION 1
+
+typedef struct {
+    char magic[8];             // "MYSTSHM"
+    uint32_t version;          // SHM_VERSION; cambia si cambia el formato
+    uint32_t header_bytes;     // sizeof(ShmHeader)
+    uint32_t num_shapes;
+    uint32_t width, height;
+    uint32_t reserved;
+    uint64_t total;            // puntos por buffer
+    uint64_t shapes_offset;    // ShmShape[num_shapes]
+    uint64_t buf_offset[2];    // xy[0], xy[1]
+    _Atomic uint64_t frame;    // frames publicados; el ultimo esta en xy[(frame-1) & 1]
+    _Atomic uint64_t seq[2];   // version de cada buffer: impar = escribiendo
+    uint64_t stamp_ns[2];      // CLOCK_MONOTONIC al publicar cada buffer (latencia)
+    _Atomic uint64_t alive;    // 1 mientras el productor corre
+    uint64_t pad[2];
+} ShmHeader;
+_Static_assert(sizeof(ShmHeader) == 128, "ShmHeader es parte del formato");
+
+typedef struct {
+    uint64_t first;            // primer punto de la figura en xy
+    uint32_t n;
+    uint8_t r, g, b, pal;
+} ShmShape;
+
+typedef struct {
+    ShmHeader* hdr;
+    float* xy[2];
+    size_t bytes;
+    long published;
+    double publish_ms;         // acumulado de shm_publish
+} ShmOut;
+
+#ifdef HAVE_SHM
+static uint64_t mono_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static bool shm_open_out(ShmOut* o, const Scene* sc, const Args* a){
+    memset(o, 0, sizeof(*o));
+    const size_t shapes_off = align64(sizeof(ShmHeader));
+    const size_t xy_bytes = align64(sizeof(float)*2*sc->total);
+    const size_t buf0 = shapes_off + align64(sizeof(ShmShape)*(size_t)sc->num_shapes);
+    o->bytes = buf0 + 2*xy_bytes;
+    int fd = shm_open(a->shm_name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0){ fprintf(stderr,"[ERR] shm_open(%s): %s\n", a->shm_name, strerror(errno)); return false; }
+    if (ftruncate(fd, (off_t)o->bytes) != 0){
+        fprintf(stderr,"[ERR] ftruncate(%s): %s\n", a->shm_name, strerror(errno));
+        close(fd); return false;
+    }
+    void* p = mmap(NULL, o->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED){ fprintf(stderr,"[ERR] mmap(%s): %s\n", a->shm_name, strerror(errno)); return false; }
+
+    ShmHeader* h = (ShmHeader*)p;
+    memset(h, 0, sizeof(*h));
+    ShmShape* S = (ShmShape*)((char*)p + shapes_off);
+    for (int s=0; s<sc->num_shapes; s++){
+        S[s].first = sc->first[s];
+        S[s].n = (uint32_t)sc->shapes[s].n;
+        S[s].r = sc->shapes[s].color.r;
+        S[s].g = sc->shapes[s].color.g;
+        S[s].b = sc->shapes[s].color.b;
+        S[s].pal = sc->shapes[s].pal;
+    }
+    h->header_bytes = sizeof(ShmHeader);
+    h->num_shapes = (uint32_t)sc->num_shapes;
+    h->width = (uint32_t)a->winW;
+    h->height = (uint32_t)a->winH;
+    h->total = sc->total;
+    h->shapes_offset = shapes_off;
+    h->buf_offset[0] = buf0;
+    h->buf_offset[1] = buf0 + xy_bytes;
+    o->hdr = h;
+    o->xy[0] = (float*)((char*)p + buf0);
+    o->xy[1] = (float*)((char*)p + buf0 + xy_bytes);
+    atomic_store_explicit(&h->alive, 1, memory_order_relaxed);
+    // magic y version al final: un lector que los ve ya tiene el resto del header
+    h->version = SHM_VERSION;
+    atomic_thread_fence(memory_order_release);
+    memcpy(h->magic, "MYSTSHM", 8);
+    return true;
+}
+
+static void shm_publish(ShmOut* o, const Scene* sc, RunMode mode){
+    double t0 = now_ms();
+    uint64_t tt = trace_begin();
+    ShmHeader* h = o->hdr;
+    const uint64_t f = atomic_load_explicit(&h->frame, memory_order_relaxed);
+    const int b = (int)(f & 1);
+    const uint64_t v = atomic_load_explicit(&h->seq[b], memory_order_relaxed);
+    atomic_store_explicit(&h->seq[b], v+1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    float* xy = o->xy[b];
+    const long total = (long)sc->total;
+    const bool soa = (sc->layout == LAYOUT_SOA);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if(mode != MODE_SEQ)
+#else
+    (void)mode;
+#endif
+    for (long k=0; k<total; k++){
+        xy[2*k]   = soa? sc->soa.x[k] : sc->pool[k].x;
+        xy[2*k+1] = soa? sc->soa.y[k] : sc->pool[k].y;
+    }
+    h->stamp_ns[b] = mono_ns();
+    atomic_store_explicit(&h->seq[b], v+2, memory_order_release);
+    atomic_store_explicit(&h->frame, f+1, memory_order_release);
+    o->published++;
+    o->publish_ms += now_ms() - t0;
+    trace_end(TR_PUBLISH, tt, 0);
+}
+
+// El nombre se desliga al salir: los lectores ya mapeados siguen leyendo el ultimo
+// frame y ven alive == 0.
+static void shm_close_out(ShmOut* o, const char* name){
+    if (!o->hdr) return;
+    atomic_store_explicit(&o->hdr->alive, 0, memory_order_release);
+    munmap(o->hdr, o->bytes);
+    shm_unlink(name);
+    o->hdr = NULL;
+}
+#else
+static bool shm_open_out(ShmOut* o, const Scene* sc, const Args* a){ (void)o; (void)sc; (void)a; return false; }
+static void shm_publish(ShmOut* o, const Scene* sc, RunMode mode){ (void)o; (void)sc; (void)mode; }
+static void shm_close_out(ShmOut* o, const char* name){ (void)o; (void)name; }
+#endif
+
+// ---------- Instantaneas (--save-state / --load-state) ----------
+// Formato v1 (orden de bytes y ABI de la maquina que guarda): una pagina de cabecera
+// y despues la arena de la escena tal como la reparte scene_carve() (Shape[] con
+// color y n, first[] y los puntos en el layout guardado). Cargar es un mmap privado
+// (copia al escribir) del archivo: si el layout coincide, la escena usa la arena
+// mapeada directamente, sin leer ni reservar nada por figura (en AoS solo se
+// recalculan los punteros Shape.points); si no, se convierte en paralelo a una arena
+// nueva. --checkpoint K copia la arena a un buffer cada K frames y un hilo de fondo
+// la escribe (archivo .tmp + rename, asi nunca queda una instantanea a medias); si
+// la escritura anterior sigue en curso el checkpoint se salta.
+#define SNAP_MAGIC    "MYSTSNP"
+#define SNAP_VERSION  1u
+#define SNAP_DATA_OFF 4096   // la arena empieza en su propia pagina
+
+typedef struct {
+    char magic[8];
+    uint32_t version, header_bytes;
+    uint32_t layout, num_shapes, max_pts, win_w, win_h;
+    uint32_t shape_bytes, point_bytes, word_bytes;   // sizeof de Shape, Point, size_t
+    uint64_t total, arena_bytes;
+    uint64_t seed, steps;        // pasos simulados desde el init
+    uint64_t checksum;           // scene_checksum() al guardar
+} SnapHeader;
+_Static_assert(sizeof(SnapHeader) <= SNAP_DATA_OFF, "cabecera de instantanea");
+
+typedef struct {
+    void* map;          // archivo completo (mmap, o leido a memoria sin POSIX)
+    size_t bytes;
+    const SnapHeader* h;
+} SnapFile;
+
+static void snap_unmap(void* map, size_t bytes){
+#ifdef HAVE_SHM
+    munmap(map, bytes);
+#else
+    (void)bytes;
+    aligned_free64(map);
+#endif
+}
+
+// Mapea y valida path; false (con [ERR]) si no es una instantanea utilizable.
+static bool snap_open(SnapFile* f, const char* path){
+    memset(f, 0, sizeof(*f));
+#ifdef HAVE_SHM
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){ fprintf(stderr,"[ERR] %s: %s\n", path, strerror(errno)); return false; }
+    off_t end = lseek(fd, 0, SEEK_END);
+    if (end < (off_t)SNAP_DATA_OFF){ fprintf(stderr,"[ERR] %s: no es una instantanea\n", path); close(fd); return false; }
+    f->bytes = (size_t)end;
+    f->map = mmap(NULL, f->bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (f->map == MAP_FAILED){ fprintf(stderr,"[ERR] mmap %s: %s\n", path, strerror(errno)); f->map = NULL; return false; }
+#else
+    FILE* in = fopen(path, "rb");
+    if (!in){ fprintf(stderr,"[ERR] %s: %s\n", path, strerror(errno)); return false; }
+    fseek(in, 0, SEEK_END);
+    long end = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    if (end < (long)SNAP_DATA_OFF){ fprintf(stderr,"[ERR] %s: no es una instantanea\n", path); fclose(in); return false; }
+    f->bytes = (size_t)end;
+    f->map = aligned_alloc64(f->bytes);
+    bool ok = fread(f->map, 1, f->bytes, in) == f->bytes;
+    fclose(in);
+    if (!ok){ fprintf(stderr,"[ERR] lectura de %s\n", path); aligned_free64(f->map); f->map = NULL; return false; }
+#endif
+    f->h = (const SnapHeader*)f->map;
+    const SnapHeader* h = f->h;
+    const char* why = NULL;
+    if (memcmp(h->magic, SNAP_MAGIC, 8) != 0) why = "no es una instantanea";
+    else if (h->version != SNAP_VERSION) why = "version no soportada";
+    else if (h->shape_bytes != sizeof(Shape) || h->point_bytes != sizeof(Point) ||
+             h->word_bytes != sizeof(size_t)) why = "guardada con otro ABI";
+    else if (h->layout > LAYOUT_SOA || h->num_shapes < 1 || h->num_shapes > MAX_SHAPES ||
+             h->max_pts < 3 || h->max_pts > MAX_PTS || h->total > (uint64_t)h->num_shapes*h->max_pts)
+        why = "cabecera invalida";
+    else {
+        Scene t;
+        memset(&t, 0, sizeof(t));
+        t.layout = (Layout)h->layout; t.num_shapes = (int)h->num_shapes; t.total = (size_t)h->total;
+        if (scene_carve(&t, NULL) != h->arena_bytes || f->bytes < SNAP_DATA_OFF + h->arena_bytes)
+            why = "archivo truncado";
+    }
+    if (why){
+        fprintf(stderr,"[ERR] %s: %s\n", path, why);
+        snap_unmap(f->map, f->bytes);
+        memset(f, 0, sizeof(*f));
+        return false;
+    }
+    return true;
+}
+
+// La figura s cabe en su rango de first[] y tiene n y color validos.
+static inline bool snap_shape_ok(const Scene* sc, int s){
+    const Shape* sh = &sc->shapes[s];
+    return sh->n >= 3 && sh->n <= sc->max_pts && sh->pal < PALETTE_SIZE &&
+           sc->first[s] <= sc->first[s+1] && sc->first[s+1] - sc->first[s] == (size_t)sh->n;
+}
+
+// Escena desde f. Con el mismo layout la escena se queda con el mapeo (f->map pasa a
+// sc->map y lo libera scene_free); si no, se copia a una arena nueva y f se cierra.
+static bool snap_scene(SnapFile* f, Scene* sc, const Args* a){
+    const SnapHeader* h = f->h;
+    Scene src;
+    memset(&src, 0, sizeof(src));
+    src.layout = (Layout)h->layout;
+    src.num_shapes = (int)h->num_shapes;
+    src.max_pts = (int)h->max_pts;
+    src.total = (size_t)h->total;
+    src.arena = (char*)f->map + SNAP_DATA_OFF;
+    src.arena_bytes = (size_t)h->arena_bytes;
+    scene_carve(&src, (char*)src.arena);
+    if (src.first[0] != 0 || src.first[src.num_shapes] != src.total){
+        fprintf(stderr,"[ERR] %s: offsets de figuras invalidos\n", a->load_state);
+        return false;
+    }
+    bool bad = false;
+    if (src.layout == a->layout){
+        *sc = src;
+        sc->map = f->map;
+        sc->map_bytes = f->bytes;
+        if (sc->layout == LAYOUT_AOS){
+#ifdef _OPENMP
+            #pragma omp parallel for schedule(static) reduction(||:bad)
+#endif
+            for (int s=0; s<sc->num_shapes; s++){
+                sc->shapes[s].points = sc->pool + sc->first[s];
+                bad = bad || !snap_shape_ok(sc, s);
+            }
+        }
+        memset(f, 0, sizeof(*f));
+    } else {
+        // Otro layout: arena nueva, con el primer toque del update
+        memset(sc, 0, sizeof(*sc));
+        sc->layout = a->layout;
+        sc->num_shapes = src.num_shapes;
+        sc->max_pts = src.max_pts;
+        sc->total = src.total;
+        sc->huge = a->hugepages;
+        scene_alloc(sc);
+        memcpy(sc->first, src.first, sizeof(size_t)*((size_t)src.num_shapes + 1));
+        const bool soa = (sc->layout == LAYOUT_SOA);
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static) reduction(||:bad)
+#endif
+        for (int s=0; s<sc->num_shapes; s++){
+            const size_t k0 = src.first[s], n = src.first[s+1] - k0;
+            sc->shapes[s] = src.shapes[s];
+            sc->shapes[s].points = soa? NULL : sc->pool + k0;
+            bad = bad || !snap_shape_ok(&src, s);
+            if (bad) continue;
+            for (size_t k=k0; k<k0+n; k++){
+                if (soa){
+                    const Point p = src.pool[k];
+                    sc->soa.x[k] = p.x; sc->soa.y[k] = p.y; sc->soa.vx[k] = p.vx; sc->soa.vy[k] = p.vy;
+                } else {
+                    Point p = { src.soa.x[k], src.soa.y[k], src.soa.vx[k], src.soa.vy[k] };
+                    sc->pool[k] = p;
+                }
+            }
+        }
+        snap_unmap(f->map, f->bytes);
+        memset(f, 0, sizeof(*f));
+    }
+    if (bad){
+        fprintf(stderr,"[ERR] %s: puntos por figura invalidos\n", a->load_state);
+        scene_free(sc);
+        return false;
+    }
+    return true;
+}
+
+// Lee solo la cabecera de --load-state y ajusta figuras, puntos y semilla (main, antes
+// de correr; --shapes/--points se ignoran). Sale con codigo 2 si no sirve.
+static void snap_apply_args(Args* a){
+    SnapFile f;
+    if (!snap_open(&f, a->load_state)) exit(2);
+    if ((int)f.h->win_w != a->winW || (int)f.h->win_h != a->winH)
+        fprintf(stderr,"[WARN] %s se guardo con ventana %ux%u y se carga en %dx%d; la trayectoria "
+                       "no sigue la de la corrida original.\n", a->load_state, f.h->win_w, f.h->win_h,
+                       a->winW, a->winH);
+    a->num_shapes = (int)f.h->num_shapes;
+    a->points_per_shape = (int)f.h->max_pts;
+    a->seed = f.h->seed;
+    snap_unmap(f.map, f.bytes);
+}
+
+// Escena inicial de una corrida: --load-state o scene_init. *steps: pasos ya simulados.
+static void scene_start(Scene* sc, const Args* a, uint64_t* steps){
+    *steps = 0;
+    if (!a->load_state){ scene_init(sc, a); return; }
+    double t0 = now_ms();
+    SnapFile f;
+    if (!snap_open(&f, a->load_state)) exit(1);
+    *steps = f.h->steps;
+    const Layout saved = (Layout)f.h->layout;
+    const unsigned long long sum = (unsigned long long)f.h->checksum;
+    if (!snap_scene(&f, sc, a)) exit(1);
+    printf("[SNAP] %s: %d figuras, %zu puntos, paso %llu (checksum %016llx) | %s en %.2f ms\n",
+           a->load_state, sc->num_shapes, sc->total, (unsigned long long)*steps, sum,
+           sc->map? "mapeada" : (saved == LAYOUT_SOA? "convertida soa->aos" : "convertida aos->soa"),
+           now_ms() - t0);
+}
+
+typedef struct {
+    const char* path;
+    char* tmp_path;
+    SDL_Thread* th;
+    SDL_mutex* lock;
+    SDL_cond* cv;
+    char* buf;            // copia de la arena que escribe el hilo de fondo
+    size_t bytes;
+    Scene view;           // la escena reapuntada a buf
+    SnapHeader hdr;
+    bool pending, quit, failed;
+    long written, skipped;
+    double copy_ms, write_ms;
+} SnapWriter;
+
+// Hilo de fondo: checksum, Shape.points a NULL y escritura .tmp + rename.
+static int snap_writer_thread(void* arg){
+    SnapWriter* w = (SnapWriter*)arg;
+#ifdef _OPENMP
+    omp_set_num_threads(1);   // scene_checksum sin abrir otro equipo de hilos
+#endif
+    SDL_LockMutex(w->lock);
+    for (;;){
+        while (!w->pending && !w->quit) SDL_CondWait(w->cv, w->lock);
+        if (!w->pending) break;
+        SDL_UnlockMutex(w->lock);
+
+        double t0 = now_ms();
+        Scene* v = &w->view;
+        if (v->layout == LAYOUT_AOS)
+            for (int s=0; s<v->num_shapes; s++) v->shapes[s].points = v->pool + v->first[s];
+        w->hdr.checksum = scene_checksum(v);
+        for (int s=0; s<v->num_shapes; s++) v->shapes[s].points = NULL;
+        static const char zeros[SNAP_DATA_OFF];
+        FILE* out = fopen(w->tmp_path, "wb");
+        bool ok = out != NULL;
+        if (ok){
+            ok = fwrite(&w->hdr, sizeof(w->hdr), 1, out) == 1 &&
+                 fwrite(zeros, SNAP_DATA_OFF - sizeof(w->hdr), 1, out) == 1 &&
+                 fwrite(w->buf, 1, w->bytes, out) == w->bytes;
+            ok = (fclose(out) == 0) && ok;
+        }
+#ifdef _WIN32
+        if (ok) remove(w->path);   // rename no reemplaza en Windows
+#endif
+        if (ok) ok = rename(w->tmp_path, w->path) == 0;
+        if (!ok){
+            fprintf(stderr,"[ERR] no se pudo escribir %s: %s\n", w->path, strerror(errno));
+            remove(w->tmp_path);
+        }
+        double dt = now_ms() - t0;
+
+        SDL_LockMutex(w->lock);
+        w->write_ms += dt;
+        if (ok) w->written++; else w->failed = true;
+        w->pending = false;
+        SDL_CondBroadcast(w->cv);
+    }
+    SDL_UnlockMutex(w->lock);
+    return 0;
+}
+
+static void snap_writer_start(SnapWriter* w, const char* path, const Scene* sc){
+    memset(w, 0, sizeof(*w));
+    w->path = path;
+    size_t n = strlen(path) + 5;
+    w->tmp_path = (char*)malloc(n);
+    if (!w->tmp_path){ fprintf(stderr,"[ERR] sin memoria (instantanea)\n"); exit(3); }
+    snprintf(w->tmp_path, n, "%s.tmp", path);
+    w->view = *sc;
+    w->view.map = NULL;
+    w->bytes = scene_carve(&w->view, NULL);
+    w->buf = (char*)aligned_alloc64(w->bytes);
+    scene_carve(&w->view, w->buf);
+    w->view.arena = w->buf;
+    w->lock = SDL_CreateMutex();
+    w->cv = SDL_CreateCond();
+    if (!w->lock || !w->cv){ fprintf(stderr,"[ERR] SDL_CreateMutex/Cond: %s\n", SDL_GetError()); exit(1); }
+    w->th = SDL_CreateThread(snap_writer_thread, "mystify-snap", w);
+    if (!w->th){ fprintf(stderr,"[ERR] SDL_CreateThread: %s\n", SDL_GetError()); exit(1); }
+}
+
+// Copia sc al buffer y despierta al escritor. Sin wait, si el escritor esta ocupado
+// el checkpoint se salta; con wait (el guardado final) espera a que termine.
+static void snap_checkpoint(SnapWriter* w, const Scene* sc, const Args* a, uint64_t steps, bool wait){
+    SDL_LockMutex(w->lock);
+    if (w->pending && !wait){ w->skipped++; SDL_UnlockMutex(w->lock); return; }
+    while (w->pending) SDL_CondWait(w->cv, w->lock);
+    SDL_UnlockMutex(w->lock);
+
+    double t0 = now_ms();
+    const size_t chunk = (size_t)1 << 20;
+    const long nchunks = (long)((w->bytes + chunk - 1) / chunk);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if(a->mode != MODE_SEQ)
+#endif
+    for (long c=0; c<nchunks; c++){
+        size_t o = (size_t)c*chunk;
+        memcpy(w->buf + o, (const char*)sc->arena + o, (w->bytes - o < chunk)? w->bytes - o : chunk);
+    }
+    SnapHeader* h = &w->hdr;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, SNAP_MAGIC, 8);
+    h->version = SNAP_VERSION;
+    h->header_bytes = (uint32_t)sizeof(SnapHeader);
+    h->layout = (uint32_t)sc->layout;
+    h->num_shapes = (uint32_t)sc->num_shapes;
+    h->max_pts = (uint32_t)sc->max_pts;
+    h->win_w = (uint32_t)a->winW;
+    h->win_h = (uint32_t)a->winH;
+    h->shape_bytes = (uint32_t)sizeof(Shape);
+    h->point_bytes = (uint32_t)sizeof(Point);
+    h->word_bytes = (uint32_t)sizeof(size_t);
+    h->total = sc->total;
+    h->arena_bytes = w->bytes;
+    h->seed = a->seed;
+    h->steps = steps;
+
+    SDL_LockMutex(w->lock);
+    w->copy_ms += now_ms() - t0;
+    w->pending = true;
+    SDL_CondSignal(w->cv);
+    if (wait) while (w->pending) SDL_CondWait(w->cv, w->lock);
+    SDL_UnlockMutex(w->lock);
+}
+
+// Espera la ultima escritura y libera. Devuelve false si alguna fallo.
+static bool snap_writer_stop(SnapWriter* w){
+    SDL_LockMutex(w->lock);
+    w->quit = true;
+    SDL_CondSignal(w->cv);
+    SDL_UnlockMutex(w->lock);
+    SDL_WaitThread(w->th, NULL);
+    SDL_DestroyCond(w->cv);
+    SDL_DestroyMutex(w->lock);
+    aligned_free64(w->buf);
+    free(w->tmp_path);
+    bool ok = !w->failed;
+    w->buf = NULL; w->tmp_path = NULL; w->th = NULL;
+    return ok;
+}
+
+// Corre por a->secs (si >0) o hasta cerrar. Si pool != NULL agrega ahi las
+// muestras por frame (sin warmup) para resumir varias repeticiones juntas.
+static RunStats run_once(SDL_Window* W, SDL_Renderer* R, const Args* a, FrameSamples* pool){
+    // W == NULL => headless: sin eventos, sin titulo y sin limite de FPS.
+    const double target_ms_per_frame = (a->fps > 0)? 1000.0/(double)a->fps : 0.0;
+    double start = now_ms();
+    double end = (a->secs>0)? (start + a->secs*1000.0) : INFINITY;
+
+    apply_schedule(a);
+    Scene scene, back_scene;
+    double ti = now_ms();
+    uint64_t steps0;
+    scene_start(&scene, a, &steps0);
+    double init_ms = now_ms() - ti;
+    if (a->mode == MODE_POOL) tpool_start(&g_tpool, tpool_nthreads());
+    SnapWriter snap;
+    if (a->save_state) snap_writer_start(&snap, a->save_state, &scene);
+    const uint64_t step0 = steps0 + a->seek;   // paso de la escena al empezar a medir
+    Analytic an;
+    memset(&an, 0, sizeof(an));
+    if (a->sim == SIM_ANALYTIC){
+        analytic_init(&an, &scene);
+        analytic_eval(&an, a->seek, a);
+    }
+    Scene* front = &scene;
+    Scene* back = &back_scene;
+    if (a->pipeline) scene_clone(&back_scene, &scene, a->loop);
+    RenderBatch batch;
+    batch_init(&batch, &scene, a->render);
+    CpuRaster raster;
+    memset(&raster, 0, sizeof(raster));
+    if (a->render == RENDER_CPU)
+        cpu_raster_init(&raster, R, a->winW, a->winH,
+                        (a->trail > 0 && a->trail_mode == TRAIL_DECAY)? trail_fade(a->trail) : 0u,
+                        a->aa? a->thick : 0.0f, a->fill, a->fill_alpha);
+    TrailHist trail;
+    memset(&trail, 0, sizeof(trail));
+    if (a->trail > 0 && a->trail_mode == TRAIL_HISTORY) trail_init(&trail, &scene, a->trail);
+    FixedStep fixed;
+    memset(&fixed, 0, sizeof(fixed));
+    Collider col;
+    memset(&col, 0, sizeof(col));
+    if (a->collide != COLLIDE_NONE) collide_init(&col, &scene, a);
+    Collider* colp = (a->collide != COLLIDE_NONE)? &col : NULL;
+    ShmOut shm;
+    memset(&shm, 0, sizeof(shm));
+    if (a->shm_name && !shm_open_out(&shm, &scene, a)) exit(1);
+    TaskFrame tasks;
+    memset(&tasks, 0, sizeof(tasks));
+    if (a->frame == FRAME_TASKS) task_frame_init(&tasks, &scene, &raster);
+
+    FrameSamples fs;
+    memset(&fs, 0, sizeof(fs));
+    bool running = true;
+    SDL_Event e;
+    int frames = 0;
+    long updates = 0;
+    double fps_timer = start;
+    double loop_start = now_ms();
+    double next_frame = loop_start;
+    if (a->tick_hz > 0) fixed_init(&fixed, &scene, a);
+
+    while (running){
+        // Eventos (solo con ventana)
+        uint64_t tev = W? trace_begin() : 0;
+        while (W && SDL_PollEvent(&e)){
+            if (e.type==SDL_QUIT) running=false;
+            if (e.type==SDL_KEYDOWN || e.type==SDL_MOUSEBUTTONDOWN) running=false;
+        }
+        if (W) trace_end(TR_EVENTS, tev, 0);
+        if (now_ms() >= end) running=false;
+        if (a->frames > 0 && frames >= a->warmup + a->frames) running=false;
+        if (!running) break;
+
+        double t0 = now_ms(), t1, u_ms, r_ms, p_ms, hid = 0.0;
+        if (a->pipeline){
+            // Render de front y update hacia back a la vez; luego swap
+            pipeline_frame(R, front, back, a, &batch, &raster, &trail, &r_ms, &p_ms, &u_ms);
+            Scene* tmp = front; front = back; back = tmp;
+            updates++;
+            t1 = now_ms();
+            // Update expuesto = lo que el frame duro de mas sobre render + present
+            double exposed = (t1 - t0) - r_ms - p_ms;
+            hid = u_ms - (exposed > 0.0 ? exposed : 0.0);
+            if (hid < 0.0) hid = 0.0;
+        } else if (a->frame == FRAME_TASKS){
+            // Update, raster y copia en un solo grafo: el update no se puede medir
+            // aparte y queda dentro de render
+            double tr = now_ms();
+            uint64_t tt = trace_begin();
+            task_frame(&tasks, front, &raster, R, a);
+            updates++;
+            tt = trace_end(TR_RENDER, tt, 0);
+            double tp = now_ms();
+            SDL_RenderPresent(R);
+            trace_end(TR_PRESENT, tt, 0);
+            t1 = now_ms();
+            u_ms = 0.0;
+            r_ms = tp - tr;
+            p_ms = t1 - tp;
+        } else if (a->tick_hz > 0){
+            // Pasos fijos pendientes, luego render de la vista interpolada
+            uint64_t tt = trace_begin();
+            int steps = fixed_advance(&fixed, front, a, colp);
+            updates += steps;
+            tt = trace_end(TR_UPDATE, tt, (uint32_t)steps);
+            double tr = now_ms();
+            fixed_interp(&fixed, front, a);
+            render_frame(R, &fixed.view, a, &batch, &raster, &trail);
+            tt = trace_end(TR_RENDER, tt, 0);
+            double tp = now_ms();
+            SDL_RenderPresent(R);
+            trace_end(TR_PRESENT, tt, 0);
+            t1 = now_ms();
+            u_ms = tr - t0;
+            r_ms = tp - tr;
+            p_ms = t1 - tp;
+        } else {
+            // Update (o la forma cerrada en el paso siguiente, en la vista)
+            if (a->sim == SIM_ANALYTIC) analytic_eval(&an, an.t + 1, a);
+            else {
+                scene_update(front, a->mode, a->loop, a->winW, a->winH);
+                if (colp) scene_collide(colp, front, a->mode);
+            }
+            updates++;
+
+            // Render (main thread)
+            double tr = now_ms();
+            uint64_t tt = trace_begin();
+            render_frame(R, (a->sim == SIM_ANALYTIC)? &an.view : front, a, &batch, &raster, &trail);
+            tt = trace_end(TR_RENDER, tt, 0);
+            double tp = now_ms();
+            SDL_RenderPresent(R);
+            trace_end(TR_PRESENT, tt, 0);
+            t1 = now_ms();
+            u_ms = tr - t0;
+            r_ms = tp - tr;
+            p_ms = t1 - tp;
+        }
+
+        // Publicacion fuera del tiempo de frame medido; va aparte en [SHM]
+        if (shm.hdr) shm_publish(&shm, (a->tick_hz > 0)? &fixed.view : (a->sim == SIM_ANALYTIC)? &an.view : front,
+                                 a->mode);
+
+        double dt = t1 - t0;
+        if (frames >= a->warmup) samples_push(&fs, dt, u_ms, r_ms, p_ms, hid);
+        frames++;
+
+        // Instantanea periodica: solo la copia al buffer entra en el frame siguiente
+        if (a->checkpoint > 0 && frames % a->checkpoint == 0){
+            snap_checkpoint(&snap, (a->sim == SIM_ANALYTIC)? analytic_snapshot(&an, a) : front, a,
+                            step0 + (uint64_t)updates, false);
+        }
+
+        // Limitar a --fps (en headless solo con --shm): plazo absoluto, asi el error
+        // no se acumula; si el frame se paso del plazo no se intenta recuperar
+        if ((W || shm.hdr) && target_ms_per_frame > 0.0){
+            next_frame += target_ms_per_frame;
+            if (next_frame < now_ms()) next_frame = now_ms();
+            else wait_until(next_frame);
+        }
+
+        // FPS cada ~500 ms en el título
+        double now = now_ms();
+        if (W && now - fps_timer >= 500.0){
+            double fps = (double)frames / ((now - start) / 1000.0);
+            char title[128];
+            snprintf(title, sizeof(title),
+                "Mystify | %s %s %s | %d shapes x %d pts (%s) | FPS: %.1f",
+                mode_name(a->mode), (a->layout==LAYOUT_SOA? "SoA":"AoS"), render_name(a->render),
+                a->num_shapes, a->points_per_shape, dist_name(a), fps);
+            SDL_SetWindowTitle(W, title);
+            fps_timer = now;
+        }
+    }
+
+    const double loop_s = (now_ms() - loop_start) / 1000.0;
+    // Forma cerrada: el estado final (con velocidades) se escribe en la base al terminar
+    if (a->sim == SIM_ANALYTIC) analytic_store(&an, &scene, a);
+    const Scene* final = front;
+    uint64_t checksum = scene_checksum(final);
+    bool snap_ok = true;
+    if (a->save_state){
+        snap_checkpoint(&snap, final, a, step0 + (uint64_t)updates, true);
+        snap_ok = snap_writer_stop(&snap);
+    }
+    const double arena_bytes = (double)scene.arena_bytes;
+    const size_t scene_total = scene.total;
+    // Bytes por frame medido: con paso fijo, los pasos promedio por frame; la forma
+    // cerrada lee el punto inicial y escribe x,y
+    const double update_bytes = (a->sim == SIM_ANALYTIC)? (double)scene.total * (sizeof(Point) + 2*sizeof(float)) :
+                                2.0 * (double)scene.total * sizeof(Point) *
+                                ((frames > 0)? (double)updates / (double)frames : 1.0);
+    const long dropped = fixed.dropped;
+    fixed_free(&fixed);
+    const double col_build = col.steps? col.build_ms/(double)col.steps : 0.0;
+    const double col_solve = col.steps? col.solve_ms/(double)col.steps : 0.0;
+    const double col_contacts = col.steps? (double)col.contacts/(double)col.steps : 0.0;
+    const int col_grid_w = col.gw, col_grid_h = col.gh;
+    collide_free(&col);
+    const int pool_nw = g_tpool.nw;
+    const long pool_epochs = g_tpool.epochs, pool_steals = atomic_load(&g_tpool.steals);
+    tpool_stop(&g_tpool);
+    const long shm_frames = shm.published;
+    const double shm_ms = shm.published? shm.publish_ms/(double)shm.published : 0.0;
+    const double shm_mb = (double)shm.bytes/(1024.0*1024.0);
+    shm_close_out(&shm, a->shm_name);
+    if (a->frame == FRAME_TASKS) task_frame_free(&tasks);
+    batch_free(&batch);
+    double fill_ms = 0.0, fill_mpx = 0.0;
+    if (a->fill != FILL_NONE) fill_stats(&raster, &fill_ms, &fill_mpx);
+    if (a->render == RENDER_CPU) cpu_raster_free(&raster);
+    trail_free(&trail);
+    analytic_free(&an);
+    scene_free(&scene);
+    if (a->pipeline) scene_free(&back_scene);
+
+    RunStats st = summarize(&fs);
+    st.checksum = checksum;
+    st.arena_bytes = arena_bytes;
+    st.update_bytes = update_bytes;
+    st.sim_steps_s = (loop_s > 0.0)? (double)updates / loop_s : 0.0;
+    st.render_fps = (loop_s > 0.0)? (double)frames / loop_s : 0.0;
+    st.collide_ms = col_build + col_solve;
+    st.contacts = col_contacts;
+    st.fill_ms = fill_ms;
+    st.fill_mpx = fill_mpx;
+    if (!W){
+        printf("[HEADLESS] %s %s %s%s%s%s%s%s%s | %d shapes x %d pts (%s, %s %s) | %d frames | %.3f ms/frame "
+               "(update %.3f, render %.3f, present %.3f; p50 %.3f p95 %.3f p99 %.3f) | %.1f FPS\n",
+               mode_name(a->mode), (a->layout==LAYOUT_SOA? "SoA":"AoS"), render_name(a->render),
+               (a->pipeline? " pipeline":""), (a->frame==FRAME_TASKS? " tasks":""), (a->aa? " aa":""), (a->fill? " fill":""),
+               (a->trail? " trail":""), (a->sim==SIM_ANALYTIC? " analytic":""), a->num_shapes, a->points_per_shape,
+               dist_name(a), loop_name(a->loop), sched_name(a->sched), st.frames, st.avg_ms, st.avg_update_ms, st.avg_render_ms, st.avg_present_ms,
+               st.p50_ms, st.p95_ms, st.p99_ms, (st.avg_ms>0.0)? 1000.0/st.avg_ms : 0.0);
+    }
+    if (a->pipeline){
+        printf("[PIPELINE] update oculto detras del render: %.1f%% de %.3f ms/frame\n",
+               st.hidden_pct, st.avg_update_ms);
+    }
+    if (a->fill != FILL_NONE) print_fill(a, fill_ms, fill_mpx);
+    if (a->tick_hz > 0){
+        printf("[TICK] %ld pasos de %.3f ms (%d Hz) | simulacion %.1f pasos/s | render %.1f FPS | "
+               "%ld pasos descartados\n", updates, 1000.0/(double)a->tick_hz, a->tick_hz,
+               st.sim_steps_s, st.render_fps, dropped);
+    }
+    if (a->collide != COLLIDE_NONE){
+        printf("[COLLIDE] %s r=%d | grid %dx%d | %.3f ms/paso (grid %.3f, choques %.3f) | "
+               "%.1f contactos/paso\n", collide_name(a->collide), a->radius, col_grid_w, col_grid_h,
+               col_build + col_solve, col_build, col_solve, col_contacts);
+    }
+    if (a->mode == MODE_POOL){
+        printf("[POOL] %d hilos | %ld epocas | %ld robos (%.2f por epoca)\n", pool_nw, pool_epochs,
+               pool_steals, pool_epochs? (double)pool_steals/(double)pool_epochs : 0.0);
+    }
+    if (a->shm_name){
+        const double frame_mb = 2.0*sizeof(float)*(double)scene_total/(1024.0*1024.0);
+        printf("[SHM] %s | segmento %.1f MB | %ld frames publicados | %.3f ms/frame (%.1f MB/s)\n",
+               a->shm_name, shm_mb, shm_frames, shm_ms, (shm_ms > 0.0)? frame_mb*1000.0/shm_ms : 0.0);
+    }
+    if (a->save_state){
+        printf("[SNAP] %s %s | %ld escritas, %ld checkpoints saltados | copia %.3f ms, escritura %.3f ms "
+               "(media)\n", a->save_state, snap_ok? "guardada" : "FALLO", snap.written, snap.skipped,
+               snap.written? snap.copy_ms/(double)(snap.written) : 0.0,
+               snap.written? snap.write_ms/(double)snap.written : 0.0);
+    }
+    printf("[CHECK] seed=%llu%s updates=%ld checksum=%016llx | init %.2f ms\n", (unsigned long long)a->seed,
+           (a->sim == SIM_ANALYTIC)? " sim=analytic" : "", (long)step0 + updates, (unsigned long long)checksum, init_ms);
+    printf("[MEM] arena %.1f MB%s | %.1f bytes/figura | update %.2f GB/s (%.1f MB por paso)\n",
+           arena_bytes/(1024.0*1024.0), a->hugepages? " (huge pages)":"",
+           arena_bytes/(double)a->num_shapes, update_gbs(&st), update_bytes/(1024.0*1024.0));
+    if (pool) samples_append(pool, &fs);
+    samples_free(&fs);
+    return st;
+}
+
+// ---------- Benchmark ----------
+static const char* layout_name(Layout l){ return (l==LAYOUT_SOA)? "soa" : "aos"; }
+
+// Salidas del benchmark: mismas filas en CSV y JSON.
+typedef struct {
+    FILE* csv;
+    FILE* json;
+    int rows;
+} BenchOut;
+
+static void write_csv_header(FILE* f){
+    fprintf(f, "mode,threads,shapes,points,width,height,secs,avg_ms_per_frame,fps,speedup,efficiency,"
+               "headless,layout,render,avg_render_ms,avg_update_ms,pipeline,update_hidden_pct,"
+               "avg_present_ms,p50_ms,p95_ms,p99_ms,stddev_ms,frames,reps,warmup,"
+               "dist,schedule,chunk,loop,seed,checksum,trail,trail_mode,"
+               "hugepages,bytes_per_shape,update_gbs,tick_hz,sim_steps_s,render_fps,"
+               "collide,radius,collide_ms,contacts,frame,aa_thick,sim,fill,fill_ms,fill_mpx_s\n");
+}
+
+// Speedup y eficiencia siempre contra la base SEQ + AoS (el camino original).
+static void write_row(BenchOut* o, const char* mode, int T, const Args* a, RunStats st, double ms_base){
+    double ms = st.avg_ms;
+    double fps = (ms>0.0)? (1000.0/ms) : 0.0;
+    double speedup = (ms>0.0)? (ms_base/ms) : 0.0;
+    double eff = (T>0)? (speedup/(double)T) : 0.0;
+    double fill_mpx_s = (st.fill_ms>0.0)? (st.fill_mpx*1000.0/st.fill_ms) : 0.0;
+    fprintf(o->csv, "%s,%d,%d,%d,%d,%d,%d,%.6f,%.3f,%.3f,%.3f,%d,%s,%s,%.6f,%.6f,%d,%.1f,"
+                    "%.6f,%.6f,%.6f,%.6f,%.6f,%d,%d,%d,%s,%s,%d,%s,%llu,%016llx,%d,%s,%d,%.1f,%.3f,%d,%.1f,%.1f,%s,%d,%.6f,%.1f,%s,%.2f,%s,%s,%.6f,%.1f\n",
+            mode, T, a->num_shapes, a->points_per_shape, a->winW, a->winH, a->secs,
+            ms, fps, speedup, eff, a->headless? 1:0, layout_name(a->layout),
+            render_name(a->render), st.avg_render_ms, st.avg_update_ms,
+            a->pipeline? 1:0, st.hidden_pct,
+            st.avg_present_ms, st.p50_ms, st.p95_ms, st.p99_ms, st.stddev_ms,
+            st.frames, a->reps, a->warmup,
+            dist_name(a), sched_name(a->sched), a->sched_chunk, loop_name(a->loop),
+            (unsigned long long)a->seed, (unsigned long long)st.checksum, a->trail, trail_name(a),
+            a->hugepages? 1:0, st.arena_bytes/(double)a->num_shapes, update_gbs(&st),
+            a->tick_hz, st.sim_steps_s, st.render_fps,
+            collide_name(a->collide), a->radius, st.collide_ms, st.contacts, frame_name(a->frame),
+            a->aa? a->thick : 0.0f, sim_name(a->sim), fill_name(a->fill), st.fill_ms, fill_mpx_s);
+    fprintf(o->json, "%s  {\"mode\":\"%s\",\"threads\":%d,\"shapes\":%d,\"points\":%d,\"width\":%d,\"height\":%d,"
+                     "\"secs\":%d,\"avg_ms_per_frame\":%.6f,\"fps\":%.3f,\"speedup\":%.3f,\"efficiency\":%.3f,"
+                     "\"headless\":%s,\"layout\":\"%s\",\"render\":\"%s\",\"pipeline\":%s,"
+                     "\"update_ms\":%.6f,\"render_ms\":%.6f,\"present_ms\":%.6f,\"update_hidden_pct\":%.1f,"
+                     "\"p50_ms\":%.6f,\"p95_ms\":%.6f,\"p99_ms\":%.6f,\"stddev_ms\":%.6f,"
+                     "\"frames\":%d,\"reps\":%d,\"warmup\":%d,"
+                     "\"dist\":\"%s\",\"schedule\":\"%s\",\"chunk\":%d,\"loop\":\"%s\","
+                     "\"seed\":%llu,\"checksum\":\"%016llx\",\"trail\":%d,\"trail_mode\":\"%s\","
+                     "\"hugepages\":%s,\"bytes_per_shape\":%.1f,\"update_gbs\":%.3f,"
+                     "\"tick_hz\":%d,\"sim_steps_s\":%.1f,\"render_fps\":%.1f,"
+                     "\"collide\":\"%s\",\"radius\":%d,\"collide_ms\":%.6f,\"contacts\":%.1f,\"frame\":\"%s\",\"aa_thick\":%.2f,\"sim\":\"%s\",\"fill\":\"%s\",\"fill_ms\":%.6f,\"fill_mpx_s\":%.1f}",
+            o->rows? ",\n" : "", mode, T, a->num_shapes, a->points_per_shape, a->winW, a->winH,
+            a->secs, ms, fps, speedup, eff,
+            a->headless? "true":"false", layout_name(a->layout), render_name(a->render),
+            a->pipeline? "true":"false",
+            st.avg_update_ms, st.avg_render_ms, st.avg_present_ms, st.hidden_pct,
+            st.p50_ms, st.p95_ms, st.p99_ms, st.stddev_ms, st.frames, a->reps, a->warmup,
+            dist_name(a), sched_name(a->sched), a->sched_chunk, loop_name(a->loop),
+            (unsigned long long)a->seed, (unsigned long long)st.checksum, a->trail, trail_name(a),
+            a->hugepages? "true":"false", st.arena_bytes/(double)a->num_shapes, update_gbs(&st),
+            a->tick_hz, st.sim_steps_s, st.render_fps,
+            collide_name(a->collide), a->radius, st.collide_ms, st.contacts, frame_name(a->frame),
+            a->aa? a->thick : 0.0f, sim_name(a->sim), fill_name(a->fill), st.fill_ms, fill_mpx_s);
+    fflush(o->csv); fflush(o->json);
+    o->rows++;
+}
+
+// a->reps corridas de la misma configuracion, resumidas juntas.
+static RunStats run_reps(SDL_Window* W, SDL_Renderer* R, const Args* a){
+    FrameSamples pool;
+    memset(&pool, 0, sizeof(pool));
+    RunStats last;
+    memset(&last, 0, sizeof(last));
+    double steps_s = 0.0, fps = 0.0;
+    for (int r=0; r<a->reps; r++){
+        last = run_once(W, R, a, &pool);
+        steps_s += last.sim_steps_s;
+        fps += last.render_fps;
+    }
+    RunStats st = summarize(&pool);
+    st.sim_steps_s = steps_s / (double)a->reps;
+    st.render_fps = fps / (double)a->reps;
+    st.checksum = last.checksum;
+    st.arena_bytes = last.arena_bytes;
+    st.update_bytes = last.update_bytes;
+    st.collide_ms = last.collide_ms;
+    st.contacts = last.contacts;
+    st.fill_ms = last.fill_ms;
+    st.fill_mpx = last.fill_mpx;
+    samples_free(&pool);
+    return st;
+}
+
+// Arranque en frio contra carga de instantanea (--bench --save-state F): guarda la
+// escena recien creada en F y mide reps veces init y carga, cada una hasta terminar el
+// primer update (el mmap difiere las lecturas a los fallos de pagina de ese update).
+static void bench_startup(const Args* user){
+    Args a = *user;
+    a.load_state = NULL;
+    Scene sc;
+    uint64_t steps0;
+    double init_ms = 0.0, init_upd = 0.0, load_ms = 0.0, load_upd = 0.0;
+    if (a.mode == MODE_POOL) tpool_start(&g_tpool, tpool_nthreads());
+    for (int r=0; r<a.reps; r++){
+        double t0 = now_ms();
+        scene_init(&sc, &a);
+        double t1 = now_ms();
+        scene_update(&sc, a.mode, a.loop, a.winW, a.winH);
+        init_ms += t1 - t0;
+        init_upd += now_ms() - t1;
+        if (r == 0){
+            SnapWriter w;
+            snap_writer_start(&w, user->save_state, &sc);
+            snap_checkpoint(&w, &sc, &a, 1, true);
+            if (!snap_writer_stop(&w)){ scene_free(&sc); tpool_stop(&g_tpool); return; }
+        }
+        scene_free(&sc);
+    }
+    Args l = a;
+    l.load_state = user->save_state;
+    for (int r=0; r<a.reps; r++){
+        double t0 = now_ms();
+        scene_start(&sc, &l, &steps0);
+        double t1 = now_ms();
+        scene_update(&sc, a.mode, a.loop, a.winW, a.winH);
+        load_ms += t1 - t0;
+        load_upd += now_ms() - t1;
+        scene_free(&sc);
+    }
+    tpool_stop(&g_tpool);
+    const double n = (double)a.reps;
+    printf("[BENCH] arranque %d x %d (%s): init %.2f ms + primer update %.2f ms | carga de %s %.2f ms + "
+           "primer update %.2f ms\n", a.num_shapes, a.points_per_shape, layout_name(a.layout),
+           init_ms/n, init_upd/n, user->save_state, load_ms/n, load_upd/n);
+}
+
+// Todas las configuraciones para un tamaño (figuras x puntos).
+static void bench_size(SDL_Window* W, SDL_Renderer* R, BenchOut* o, Args a, const int* Ts, int nT, int maxT){
+    // Medimos secuencial primero como base (AoS), luego SEQ con SoA
+    const Args user = a;
+    if (user.save_state) bench_startup(&user);
+    a.save_state = NULL;  // las corridas del barrido no escriben instantaneas
+    a.checkpoint = 0;
+    a.sim = SIM_STEP;     // la forma cerrada tiene su propia fila
+    a.seek = 0;
+    a.mode = MODE_SEQ;
+    a.pipeline = false;
+    a.trail = 0;        // estelas, paso fijo y choques tienen sus propias filas al final
+    a.tick_hz = 0;
+    a.collide = COLLIDE_NONE;
+    a.frame = FRAME_FORK;
+    a.aa = false;
+    a.fill = FILL_NONE;
+    a.layout = LAYOUT_AOS;
+    printf("[BENCH] %d x %d | SEQ aos ...\n", a.num_shapes, a.points_per_shape);
+    RunStats base = run_reps(W,R,&a);
+    double ms_seq = base.avg_ms;
+    write_row(o, "seq", 1, &a, base, ms_seq);
+
+    Args soa = a; soa.layout = LAYOUT_SOA;
+    printf("[BENCH] %d x %d | SEQ soa ...\n", a.num_shapes, a.points_per_shape);
+    write_row(o, "seq", 1, &soa, run_reps(W,R,&soa), ms_seq);
+
+#ifdef _OPENMP
+    // Hilos de la lista, con ambos layouts
+    for (int k=0; k<nT; k++){
+        int T = Ts[k];
+        for (int l=LAYOUT_AOS; l<=LAYOUT_SOA; l++){
+            printf("[BENCH] %d x %d | OMP %s threads=%d ...\n", a.num_shapes, a.points_per_shape,
+                   layout_name((Layout)l), T);
+            // Fijar num threads para esta corrida
+            omp_set_num_threads(T);
+            Args b = a; b.mode = MODE_OMP; b.layout = (Layout)l;
+            write_row(o, "omp", T, &b, run_reps(W,R,&b), ms_seq);
+            // Mismo update en el pool propio (mismo numero de hilos)
+            printf("[BENCH] %d x %d | POOL %s threads=%d ...\n", a.num_shapes, a.points_per_shape,
+                   layout_name((Layout)l), T);
+            b.mode = MODE_POOL;
+            write_row(o, "pool", T, &b, run_reps(W,R,&b), ms_seq);
+        }
+    }
+    omp_set_num_threads(maxT);
+
+    // Schedules x loop (por figura / aplanado) con todos los hilos, layout y --dist pedidos
+    for (int lp=LOOP_SHAPE; lp<=LOOP_POINT; lp++){
+        for (int k=SCHED_STATIC; k<=SCHED_GUIDED; k++){
+            Args sb = a;
+            sb.mode = MODE_OMP;
+            sb.layout = user.layout;
+            sb.loop = (LoopKind)lp;
+            sb.sched = (SchedKind)k;
+            printf("[BENCH] %d x %d | %s loop=%s schedule=%s ...\n", a.num_shapes, a.points_per_shape,
+                   dist_name(&sb), loop_name(sb.loop), sched_name(sb.sched));
+            write_row(o, "omp", maxT, &sb, run_reps(W,R,&sb), ms_seq);
+        }
+    }
+#else
+    (void)Ts; (void)nT;
+    // Sin OpenMP el pool es el unico update paralelo
+    for (int l=LAYOUT_AOS; l<=LAYOUT_SOA; l++){
+        Args b = a; b.mode = MODE_POOL; b.layout = (Layout)l;
+        printf("[BENCH] %d x %d | POOL %s threads=%d ...\n", a.num_shapes, a.points_per_shape,
+               layout_name(b.layout), tpool_nthreads());
+        write_row(o, "pool", tpool_nthreads(), &b, run_reps(W,R,&b), ms_seq);
+    }
+#endif
+
+    // Caminos de render, con el modo y layout pedidos y todos los hilos
+    Args rb = a;
+    rb.mode = user.mode;
+    rb.layout = user.layout;
+    RunStats step_st;
+    memset(&step_st, 0, sizeof(step_st));
+    for (int r=RENDER_LEGACY; r<=RENDER_CPU; r++){
+#if !SDL_VERSION_ATLEAST(2,0,18)
+        if (r == RENDER_GEOM) continue;
+#endif
+        rb.render = (RenderPath)r;
+        printf("[BENCH] %d x %d | render %s ...\n", a.num_shapes, a.points_per_shape, render_name(rb.render));
+        RunStats st = run_reps(W,R,&rb);
+        if (rb.render == user.render) step_st = st;
+        write_row(o, rb.mode==MODE_SEQ? "seq":"omp", rb.mode==MODE_SEQ? 1 : maxT, &rb, st, ms_seq);
+    }
+
+    // Forma cerrada contra la fila por pasos del mismo render de arriba (update = evaluar
+    // la vista), y cuanto se aparta del update por pasos en float
+    Args xb = rb;
+    xb.render = user.render;
+    xb.sim = SIM_ANALYTIC;
+    printf("[BENCH] %d x %d | sim analytic (%s) ...\n", a.num_shapes, a.points_per_shape, render_name(xb.render));
+    RunStats an_st = run_reps(W,R,&xb);
+    write_row(o, xb.mode==MODE_SEQ? "seq":"omp", xb.mode==MODE_SEQ? 1 : maxT, &xb, an_st, ms_seq);
+    printf("[BENCH] %d x %d | update por frame: analytic %.3f ms, %.1f MB | pasos %.3f ms, %.1f MB\n",
+           a.num_shapes, a.points_per_shape, an_st.avg_update_ms, an_st.update_bytes/(1024.0*1024.0),
+           step_st.avg_update_ms, step_st.update_bytes/(1024.0*1024.0));
+    double ref_err, step_err, step_pct;
+    long ref_bad;
+    analytic_check(&xb, ANALYTIC_CHECK_STEPS, &ref_err, &ref_bad, &step_err, &step_pct);
+    printf("[BENCH] %d x %d | analytic tras %d pasos: vs bounce() en double error max %.3g px (%ld puntos > %g px) | "
+           "vs pasos en float error max %.3g px, %.2f%% de los puntos a < 0.01 px\n",
+           a.num_shapes, a.points_per_shape, ANALYTIC_CHECK_STEPS, ref_err, ref_bad, ANALYTIC_CHECK_TOL,
+           step_err, step_pct);
+    if (ref_bad > 0) fprintf(stderr, "[WARN] la forma cerrada se aparta de bounce() mas de %g px\n", ANALYTIC_CHECK_TOL);
+
+#ifdef _OPENMP
+    // Pipeline (update traslapado con render) con el render pedido
+    Args pb = a;
+    pb.mode = MODE_OMP;
+    pb.layout = user.layout;
+    pb.render = user.render;
+    pb.pipeline = true;
+    printf("[BENCH] %d x %d | pipeline %s ...\n", a.num_shapes, a.points_per_shape, render_name(pb.render));
+    write_row(o, "omp", maxT, &pb, run_reps(W,R,&pb), ms_seq);
+
+    // Grafo de tareas contra la fila render cpu (fork/join) de arriba
+    Args gb = a;
+    gb.mode = MODE_OMP;
+    gb.layout = user.layout;
+    gb.render = RENDER_CPU;
+    gb.frame = FRAME_TASKS;
+    printf("[BENCH] %d x %d | frame tasks ...\n", a.num_shapes, a.points_per_shape);
+    write_row(o, "omp", maxT, &gb, run_reps(W,R,&gb), ms_seq);
+#endif
+
+    // Lineas AA (1 px y gruesas) contra la fila render cpu de arriba
+    Args ab = rb;
+    ab.render = RENDER_CPU;
+    ab.aa = true;
+    for (int v=0; v<2; v++){
+        ab.thick = (v == 0)? 1.0f : (user.thick > 1.0f? user.thick : 3.0f);
+        printf("[BENCH] %d x %d | render cpu aa %.1f px ...\n", a.num_shapes, a.points_per_shape, ab.thick);
+        write_row(o, ab.mode==MODE_SEQ? "seq":"omp", ab.mode==MODE_SEQ? 1 : maxT,
+                  &ab, run_reps(W,R,&ab), ms_seq);
+    }
+
+    // Relleno con las dos reglas contra la fila render cpu de arriba; fill_mpx_s es el
+    // throughput de la pasada de bandas
+    Args lb = rb;
+    lb.render = RENDER_CPU;
+    for (int f=FILL_EVENODD; f<=FILL_NONZERO; f++){
+        lb.fill = (FillRule)f;
+        printf("[BENCH] %d x %d | render cpu fill %s ...\n", a.num_shapes, a.points_per_shape, fill_name(lb.fill));
+        write_row(o, lb.mode==MODE_SEQ? "seq":"omp", lb.mode==MODE_SEQ? 1 : maxT,
+                  &lb, run_reps(W,R,&lb), ms_seq);
+    }
+
+    // Estelas: historial con lineas SDL y decay del framebuffer (render cpu); comparar
+    // con las filas sin estela del mismo render de arriba
+    Args tb = rb;
+    tb.trail = user.trail > 0 ? user.trail : DEF_TRAIL;
+    for (int m=TRAIL_HISTORY; m<=TRAIL_DECAY; m++){
+        tb.trail_mode = (TrailMode)m;
+        if (m == TRAIL_DECAY) tb.render = RENDER_CPU;
+        else tb.render = (user.render == RENDER_CPU)? RENDER_BATCH : user.render;
+        printf("[BENCH] %d x %d | trail %d %s (%s) ...\n", a.num_shapes, a.points_per_shape,
+               tb.trail, trail_name(&tb), render_name(tb.render));
+        write_row(o, tb.mode==MODE_SEQ? "seq":"omp", tb.mode==MODE_SEQ? 1 : maxT,
+                  &tb, run_reps(W,R,&tb), ms_seq);
+    }
+
+    // Paso fijo: pasos/s de simulacion y FPS de render por separado
+    Args fb = rb;
+    fb.render = user.render;
+    fb.tick_hz = user.tick_hz > 0 ? user.tick_hz : 120;
+    printf("[BENCH] %d x %d | tick %d Hz ...\n", a.num_shapes, a.points_per_shape, fb.tick_hz);
+    write_row(o, fb.mode==MODE_SEQ? "seq":"omp", fb.mode==MODE_SEQ? 1 : maxT,
+              &fb, run_reps(W,R,&fb), ms_seq);
+
+    // Choques con el grid: con --shapes-list se ve el tiempo por frame contra figuras
+    Args cb = rb;
+    cb.render = user.render;
+    cb.collide = (user.collide != COLLIDE_NONE)? user.collide : COLLIDE_POINTS;
+    printf("[BENCH] %d x %d | collide %s r=%d ...\n", a.num_shapes, a.points_per_shape,
+           collide_name(cb.collide), cb.radius);
+    write_row(o, cb.mode==MODE_SEQ? "seq":"omp", cb.mode==MODE_SEQ? 1 : maxT,
+              &cb, run_reps(W,R,&cb), ms_seq);
+}
+
+static void bench_all(SDL_Window* W, SDL_Renderer* R, Args a){
+    // Prepara CSV y JSON
+    BenchOut o = { NULL, NULL, 0 };
+    o.csv = fopen("bench.csv","w");
+    if (!o.csv){ fprintf(stderr,"[ERR] no se pudo crear bench.csv\n"); return; }
+    o.json = fopen("bench.json","w");
+    if (!o.json){ fprintf(stderr,"[ERR] no se pudo crear bench.json\n"); fclose(o.csv); return; }
+    write_csv_header(o.csv);
+    fprintf(o.json, "[\n");
+
+    if (a.frames == 0) a.secs = (a.secs>0? a.secs: 8); // por si no pusieron --secs
+
+    // Hilos: --threads o potencias de 2 hasta el maximo
+    int maxT = omp_get_max_threads();
+    int Ts[MAX_LIST], nT = 0;
+    if (a.n_threads > 0){
+        memcpy(Ts, a.threads_list, sizeof(int)*a.n_threads);
+        nT = a.n_threads;
+    } else {
+        for (int T=1; T<=maxT && nT<MAX_LIST; T<<=1) Ts[nT++] = T;
+    }
+#ifndef _OPENMP
+    printf("[BENCH] OpenMP no disponible; solo SEQ registrado.\n");
+#endif
+
+    int nS = a.n_shapes_list? a.n_shapes_list : 1;
+    int nP = a.n_points_list? a.n_points_list : 1;
+    for (int si=0; si<nS; si++){
+        for (int pi=0; pi<nP; pi++){
+            Args b = a;
+            if (a.n_shapes_list) b.num_shapes = a.shapes_list[si];
+            if (a.n_points_list) b.points_per_shape = a.points_list[pi];
+            bench_size(W, R, &o, b, Ts, nT, maxT);
+        }
+    }
+
+    fprintf(o.json, "\n]\n");
+    fclose(o.json);
+    fclose(o.csv);
+    printf("[BENCH] Listo: bench.csv, bench.json\n");
+}
+
+// ---------- Autoajuste (--autotune) ----------
+// Calibracion corta al arrancar, con la escena real (figuras, puntos, --dist y layout
+// pedidos) y midiendo solo el update: primero el numero de hilos (1, potencias de 2,
+// nucleos fisicos y logicos: con SMT omp_get_max_threads() no siempre es lo mejor) y
+// despues, con esos hilos, schedule x chunk x --loop. Cada candidato cuenta por su
+// mejor paso. El ganador va a --tune-cache (texto, una linea por clave: modelo de
+// CPU, CPUs logicas, modo, layout y tamaño), asi la siguiente corrida igual arranca
+// ajustada sin calibrar.
+#define TUNE_STEPS     8      // updates medidos por candidato
+#define TUNE_CAND_MS   80.0   // tope por candidato (figuras muy grandes)
+#define TUNE_KEY       384
+
+typedef struct {
+    int threads;
+    SchedKind sched;
+    int chunk;
+    LoopKind loop;
+    double ms;        // mejor update medido
+} TuneChoice;
+
+#ifdef _OPENMP
+// Modelo de CPU sin espacios (para la clave del cache).
+static void tune_cpu_model(char* out, size_t n){
+    snprintf(out, n, "desconocido");
+#if defined(__linux__)
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    if (f){
+        char line[512];
+        while (fgets(line, sizeof(line), f)){
+            char* c = strchr(line, ':');
+            if (!c) continue;
+            if (!strncmp(line, "model name", 10) || !strncmp(line, "Model", 5) ||
+                !strncmp(line, "cpu model", 9) || !strncmp(line, "uarch", 5)){
+                c++;
+                while (*c == ' ' || *c == '\t') c++;
+                c[strcspn(c, "\n")] = '\0';
+                if (*c){ snprintf(out, n, "%s", c); break; }
+            }
+        }
+        fclose(f);
+    }
+#elif defined(__APPLE__)
+    size_t len = n;
+    if (sysctlbyname("machdep.cpu.brand_string", out, &len, NULL, 0) != 0) snprintf(out, n, "desconocido");
+#endif
+    for (char* p = out; *p; p++)
+        if (!((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+              *p == '.' || *p == '-')) *p = '_';
+}
+
+// Nucleos fisicos: CPUs que son la primera de su lista de hermanos SMT (Linux).
+// Sin topologia legible, las CPUs logicas.
+static int tune_physical_cores(int logical){
+#ifdef __linux__
+    int cores = 0;
+    for (int c=0; c<logical; c++){
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+        FILE* f = fopen(path, "r");
+        if (!f) return logical;
+        int first = -1;
+        if (fscanf(f, "%d", &first) != 1) first = -1;
+        fclose(f);
+        if (first < 0) return logical;
+        if (first == c) cores++;
+    }
+    return cores > 0? cores : logical;
+#else
+    return logical;
+#endif
+}
+
+// Todo lo que cambia el costo del update medido: --sim, --collide y --pipeline, y el
+// --loop/--schedule pedidos (son el candidato de partida).
+static void tune_key(char* key, size_t n, const Args* a){
+    char cpu[128];
+    tune_cpu_model(cpu, sizeof(cpu));
+    snprintf(key, n, "%s|cpus=%d|%s|%s|%dx%d|%s|sim=%s|collide=%s|pipeline=%d|loop=%s|sched=%s,%d",
+             cpu, SDL_GetCPUCount(), mode_name(a->mode), layout_name(a->layout), a->num_shapes,
+             a->points_per_shape, dist_name(a), sim_name(a->sim), collide_name(a->collide),
+             a->pipeline? 1 : 0, loop_name(a->loop), sched_name(a->sched), a->sched_chunk);
+}
+
+// Linea "clave hilos schedule chunk loop ms" de path; false si no esta.
+static bool tune_cache_get(const char* path, const char* key, TuneChoice* t){
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[TUNE_KEY + 96], k[TUNE_KEY], sched[16], loop[16];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), f)){
+        if (sscanf(line, "%383s %d %15s %d %15s %lf", k, &t->threads, sched, &t->chunk, loop, &t->ms) != 6 ||
+            strcmp(k, key) != 0) continue;
+        t->sched = !strcmp(sched, "dynamic")? SCHED_DYNAMIC : !strcmp(sched, "guided")? SCHED_GUIDED : SCHED_STATIC;
+        t->loop = !strcmp(loop, "point")? LOOP_POINT : LOOP_SHAPE;
+        found = t->threads >= 1 && t->chunk >= 0;
+    }
+    fclose(f);
+    return found;
+}
+
+// Reescribe path con la linea de key reemplazada (path.tmp + rename).
+static void tune_cache_put(const char* path, const char* key, const TuneChoice* t){
+    size_t n = strlen(path) + 5;
+    char* tmp = (char*)malloc(n);
+    if (!tmp){ fprintf(stderr,"[ERR] sin memoria (autotune)\n"); exit(3); }
+    snprintf(tmp, n, "%s.tmp", path);
+    FILE* out = fopen(tmp, "w");
+    if (!out){ fprintf(stderr,"[WARN] no se pudo escribir %s: %s\n", tmp, strerror(errno)); free(tmp); return; }
+    FILE* in = fopen(path, "r");
+    if (in){
+        char line[TUNE_KEY + 96], k[TUNE_KEY];
+        while (fgets(line, sizeof(line), in))
+            if (sscanf(line, "%383s", k) == 1 && strcmp(k, key) != 0) fputs(line, out);
+        fclose(in);
+    }
+    fprintf(out, "%s %d %s %d %s %.6f\n", key, t->threads, sched_name(t->sched), t->chunk, loop_name(t->loop), t->ms);
+    bool ok = fclose(out) == 0;
+#ifdef _WIN32
+    if (ok) remove(path);
+#endif
+    if (!ok || rename(tmp, path) != 0){
+        fprintf(stderr,"[WARN] no se pudo actualizar %s\n", path);
+        remove(tmp);
+    }
+    free(tmp);
+}
+
+// Mejor update (ms) de sc con la configuracion c.
+static double tune_measure(Scene* sc, const Args* a, const TuneChoice* c){
+    Args b = *a;
+    b.sched = c->sched;
+    b.sched_chunk = c->chunk;
+    b.loop = c->loop;
+    omp_set_num_threads(c->threads);
+    apply_schedule(&b);
+    if (a->mode == MODE_POOL) tpool_start(&g_tpool, c->threads);
+    scene_update(sc, a->mode, b.loop, a->winW, a->winH);   // calienta hilos y cache
+    double best = INFINITY, t_start = now_ms();
+    for (int r=0; r<TUNE_STEPS; r++){
+        double t0 = now_ms();
+        scene_update(sc, a->mode, b.loop, a->winW, a->winH);
+        double dt = now_ms() - t0;
+        if (dt < best) best = dt;
+        if (now_ms() - t_start > TUNE_CAND_MS && r >= 1) break;
+    }
+    if (a->mode == MODE_POOL) tpool_stop(&g_tpool);
+    return best;
+}
+
+// Un candidato gana solo si mejora en mas de 2% al mejor anterior: ante empate quedan
+// menos hilos y la configuracion pedida.
+static TuneChoice tune_calibrate(const Args* a, int defT, double* default_ms, int* tried){
+    Scene sc;
+    scene_init(&sc, a);
+    const int logical = SDL_GetCPUCount() > 0? SDL_GetCPUCount() : 1;
+    const int maxT = defT > logical? defT : logical;
+    int Ts[MAX_LIST], nT = 0;
+    for (int T=1; T<maxT && nT<MAX_LIST-3; T<<=1) Ts[nT++] = T;
+    Ts[nT++] = tune_physical_cores(logical);
+    Ts[nT++] = defT;
+    Ts[nT++] = maxT;
+    *tried = 0;
+
+    // 1) hilos, con el schedule y el loop pedidos
+    TuneChoice best = { 1, a->sched, a->sched_chunk, a->loop, INFINITY }, c = best;
+    *default_ms = INFINITY;
+    for (int k=0; k<nT; k++){
+        bool dup = false;
+        for (int j=0; j<k; j++) dup = dup || Ts[j] == Ts[k];
+        if (dup) continue;
+        c.threads = Ts[k];
+        c.ms = tune_measure(&sc, a, &c);
+        (*tried)++;
+        if (Ts[k] == defT) *default_ms = c.ms;
+        if (c.ms < best.ms * 0.98) best = c;
+    }
+    // 2) con esos hilos: loop x schedule x chunk (el pool solo reparte segun el loop)
+    static const struct { SchedKind k; int chunk; } scheds[] = {
+        { SCHED_STATIC, 0 }, { SCHED_STATIC, 16 }, { SCHED_DYNAMIC, 4 }, { SCHED_DYNAMIC, 32 },
+        { SCHED_DYNAMIC, 256 }, { SCHED_GUIDED, 0 }, { SCHED_GUIDED, 8 } };
+    const bool pool = (a->mode == MODE_POOL);
+    const int nsched = pool? 1 : (int)(sizeof(scheds)/sizeof(scheds[0]));
+    c = best;
+    for (int lp=LOOP_SHAPE; lp<=LOOP_POINT; lp++){
+        for (int k=0; k<nsched; k++){
+            c.loop = (LoopKind)lp;
+            c.sched = pool? a->sched : scheds[k].k;
+            c.chunk = pool? a->sched_chunk : scheds[k].chunk;
+            if (c.loop == a->loop && c.sched == a->sched && c.chunk == a->sched_chunk) continue;  // ya medido
+            c.ms = tune_measure(&sc, a, &c);
+            (*tried)++;
+            if (c.ms < best.ms * 0.98) best = c;
+        }
+    }
+    scene_free(&sc);
+    return best;
+}
+#endif
+
+// Fija hilos, schedule y loop para el resto de la corrida: del cache si la clave ya
+// esta, si no calibrando (y guardando).
+static void autotune(Args* a){
+#ifdef _OPENMP
+    char key[TUNE_KEY];
+    tune_key(key, sizeof(key), a);
+    TuneChoice t;
+    double t0 = now_ms();
+    const int defT = omp_get_max_threads();
+    if (tune_cache_get(a->tune_cache, key, &t)){
+        printf("[TUNE] %s (cache): %d hilos, schedule %s,%d, loop %s | %.3f ms/update al calibrar\n",
+               a->tune_cache, t.threads, sched_name(t.sched), t.chunk, loop_name(t.loop), t.ms);
+    } else {
+        double def_ms;
+        int tried;
+        t = tune_calibrate(a, defT, &def_ms, &tried);
+        tune_cache_put(a->tune_cache, key, &t);
+        printf("[TUNE] calibrado en %.0f ms (%d candidatos): %d hilos, schedule %s,%d, loop %s | "
+               "%.3f ms/update (%d hilos por defecto: %.3f ms, x%.2f) -> %s\n",
+               now_ms() - t0, tried, t.threads, sched_name(t.sched), t.chunk, loop_name(t.loop), t.ms,
+               defT, def_ms, (t.ms > 0.0)? def_ms/t.ms : 0.0, a->tune_cache);
+    }
+    omp_set_num_threads(t.threads);
+    a->sched = t.sched;
+    a->sched_chunk = t.chunk;
+    a->loop = t.loop;
+#else
+    (void)a;
+#endif
+}
+
+// ---------- Exportacion ----------
+// Cola acotada de EXPORT_SLOTS buffers reutilizables: el hilo principal simula,
+// rasteriza y convierte al buffer n % EXPORT_SLOTS mientras el hilo escritor manda a
+// disco los anteriores. Si el disco no alcanza, el productor espera un buffer libre.
+#define EXPORT_SLOTS 4
+
+typedef enum { EXPORT_Y4M=0, EXPORT_PPM=1 } ExportFormat;
+
+typedef struct {
+    ExportFormat fmt;
+    const char* path;       // .y4m, o patron printf de PPM
+    FILE* f;                // solo Y4M
+    int w, h;
+    size_t frame_bytes;
+    uint8_t* slot[EXPORT_SLOTS];
+    int produced, written;  // contadores monotonicos (bajo lock)
+    int total;              // frames que el escritor debe esperar
+    bool failed;
+    SDL_mutex* lock;
+    SDL_cond* has_frame;    // escritor: produced > written
+    SDL_cond* has_slot;     // productor: produced - written < EXPORT_SLOTS
+    double wait_ms;         // productor bloqueado por la cola llena
+    uint64_t bytes;         // escritos a disco (solo el escritor)
+} ExportQueue;
+
+static bool has_suffix(const char* s, const char* suf){
+    size_t n = strlen(s), m = strlen(suf);
+    return n >= m && !strcmp(s + n - m, suf);
+}
+
+static bool export_open(ExportQueue* q, const Args* a){
+    memset(q, 0, sizeof(*q));
+    q->path = a->export_path;
+    q->w = a->winW; q->h = a->winH;
+    q->total = a->frames;
+    if (has_suffix(q->path, ".y4m")){
+        q->fmt = EXPORT_Y4M;
+        q->frame_bytes = (size_t)q->w*q->h + 2*(size_t)((q->w+1)/2)*((q->h+1)/2);
+        q->f = fopen(q->path, "wb");
+        if (!q->f){ fprintf(stderr,"[ERR] no se pudo crear %s\n", q->path); return false; }
+        fprintf(q->f, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n", q->w, q->h);
+    } else if (strchr(q->path, '%')){
+        q->fmt = EXPORT_PPM;
+        q->frame_bytes = (size_t)q->w*q->h*3;
+    } else {
+        fprintf(stderr,"[ERR] --export espera un .y4m o un patron PPM con %%d (p.ej. f%%05d.ppm)\n");
+        return false;
+    }
+    for (int k=0; k<EXPORT_SLOTS; k++) q->slot[k] = (uint8_t*)aligned_alloc64(q->frame_bytes);
+    q->lock = SDL_CreateMutex();
+    q->has_frame = SDL_CreateCond();
+    q->has_slot = SDL_CreateCond();
+    if (!q->lock || !q->has_frame || !q->has_slot){
+        fprintf(stderr,"[ERR] SDL mutex/cond: %s\n", SDL_GetError()); exit(1);
+    }
+    return true;
+}
+
+static void export_close(ExportQueue* q){
+    if (q->f) fclose(q->f);
+    for (int k=0; k<EXPORT_SLOTS; k++) if (q->slot[k]) aligned_free64(q->slot[k]);
+    SDL_DestroyCond(q->has_slot);
+    SDL_DestroyCond(q->has_frame);
+    SDL_DestroyMutex(q->lock);
+}
+
+static bool export_write(ExportQueue* q, int n, const uint8_t* buf){
+    if (q->fmt == EXPORT_Y4M){
+        if (fputs("FRAME\n", q->f) < 0 || fwrite(buf, 1, q->frame_bytes, q->f) != q->frame_bytes) return false;
+        q->bytes += 6 + q->frame_bytes;
+        return true;
+    }
+    char name[1024];
+    snprintf(name, sizeof(name), q->path, n);
+    FILE* f = fopen(name, "wb");
+    if (!f){ fprintf(stderr,"[ERR] no se pudo crear %s\n", name); return false; }
+    int hdr = fprintf(f, "P6\n%d %d\n255\n", q->w, q->h);
+    bool ok = hdr > 0 && fwrite(buf, 1, q->frame_bytes, f) == q->frame_bytes;
+    if (fclose(f) != 0) ok = false;
+    if (ok) q->bytes += (uint64_t)hdr + q->frame_bytes;
+    return ok;
+}
+
+// Hilo escritor: frame n sale del buffer n % EXPORT_SLOTS, en orden.
+static int export_writer(void* p){
+    ExportQueue* q = (ExportQueue*)p;
+    SDL_LockMutex(q->lock);
+    for (int n=0; ; n++){
+        while (q->produced <= n && n < q->total) SDL_CondWait(q->has_frame, q->lock);
+        if (n >= q->total) break;
+        bool skip = q->failed;
+        SDL_UnlockMutex(q->lock);
+        bool ok = skip || export_write(q, n, q->slot[n % EXPORT_SLOTS]);
+        SDL_LockMutex(q->lock);
+        if (!ok){
+            if (!q->failed) fprintf(stderr,"[ERR] fallo la escritura del frame %d\n", n);
+            q->failed = true;
+        }
+        q->written = n+1;
+        SDL_CondSignal(q->has_slot);
+    }
+    SDL_UnlockMutex(q->lock);
+    return 0;
+}
+
+// Buffer libre para el siguiente frame (NULL si el escritor fallo).
+static uint8_t* export_acquire(ExportQueue* q){
+    double t0 = now_ms();
+    SDL_LockMutex(q->lock);
+    while (q->produced - q->written >= EXPORT_SLOTS && !q->failed) SDL_CondWait(q->has_slot, q->lock);
+    bool failed = q->failed;
+    SDL_UnlockMutex(q->lock);
+    q->wait_ms += now_ms() - t0;
+    return failed? NULL : q->slot[q->produced % EXPORT_SLOTS];
+}
+
+static void export_commit(ExportQueue* q){
+    SDL_LockMutex(q->lock);
+    q->produced++;
+    SDL_CondSignal(q->has_frame);
+    SDL_UnlockMutex(q->lock);
+}
+
+// ARGB -> Y'CbCr 4:2:0 (BT.601, rango limitado, croma promediada en 2x2). Cada
+// iteracion escribe dos filas de luma y una de croma: sin solapes entre hilos.
+static void export_fill_y4m(const Framebuffer* fb, uint8_t* out){
+    const int w = fb->w, h = fb->h, cw = (w+1)/2, ch = (h+1)/2;
+    uint8_t* Y = out;
+    uint8_t* U = out + (size_t)w*h;
+    uint8_t* V = U + (size_t)cw*ch;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int cy=0; cy<ch; cy++){
+        const int y0 = 2*cy, y1 = (2*cy+1 < h)? 2*cy+1 : h-1;
+        for (int y=y0; y<=y1; y++){
+            const uint32_t* row = &fb->px[(size_t)y*w];
+            uint8_t* yr = Y + (size_t)y*w;
+            for (int x=0; x<w; x++){
+                int r = (row[x] >> 16) & 0xFF, g = (row[x] >> 8) & 0xFF, b = row[x] & 0xFF;
+                yr[x] = (uint8_t)(((66*r + 129*g + 25*b + 128) >> 8) + 16);
+            }
+        }
+        const uint32_t* r0 = &fb->px[(size_t)y0*w];
+        const uint32_t* r1 = &fb->px[(size_t)y1*w];
+        for (int cx=0; cx<cw; cx++){
+            const int x0 = 2*cx, x1 = (2*cx+1 < w)? 2*cx+1 : w-1;
+            const uint32_t q[4] = { r0[x0], r0[x1], r1[x0], r1[x1] };
+            int r = 0, g = 0, b = 0;
+            for (int k=0; k<4; k++){ r += (q[k] >> 16) & 0xFF; g += (q[k] >> 8) & 0xFF; b += q[k] & 0xFF; }
+            r = (r+2) >> 2; g = (g+2) >> 2; b = (b+2) >> 2;
+            // +128*256 adelanta el offset de croma: el numerador nunca es negativo
+            U[(size_t)cy*cw + cx] = (uint8_t)((-38*r -  74*g + 112*b + 32896) >> 8);
+            V[(size_t)cy*cw + cx] = (uint8_t)((112*r -  94*g -  18*b + 32896) >> 8);
+        }
+    }
+}
+
+static void export_fill_ppm(const Framebuffer* fb, uint8_t* out){
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int y=0; y<fb->h; y++){
+        const uint32_t* row = &fb->px[(size_t)y*fb->w];
+        uint8_t* o = out + (size_t)y*fb->w*3;
+        for (int x=0; x<fb->w; x++){
+            o[3*x+0] = (uint8_t)(row[x] >> 16);
+            o[3*x+1] = (uint8_t)(row[x] >> 8);
+            o[3*x+2] = (uint8_t)row[x];
+        }
+    }
+}
+
+// --export: a->frames cuadros lo mas rapido posible (sin tiempo real ni present).
+static void run_export(SDL_Renderer* R, const Args* a){
+    ExportQueue q;
+    if (!export_open(&q, a)) exit(1);
+    apply_schedule(a);
+    Scene scene;
+    uint64_t steps0;
+    scene_start(&scene, a, &steps0);
+    SnapWriter snap;
+    if (a->save_state) snap_writer_start(&snap, a->save_state, &scene);
+    steps0 += a->seek;
+    Analytic an;
+    memset(&an, 0, sizeof(an));
+    if (a->sim == SIM_ANALYTIC){
+        analytic_init(&an, &scene);
+        analytic_eval(&an, a->seek, a);
+    }
+    const Scene* draw = (a->sim == SIM_ANALYTIC)? &an.view : &scene;
+    CpuRaster raster;
+    cpu_raster_init(&raster, R, a->winW, a->winH, (a->trail > 0)? trail_fade(a->trail) : 0u,
+                    a->aa? a->thick : 0.0f, a->fill, a->fill_alpha);
+    Collider col;
+    memset(&col, 0, sizeof(col));
+    if (a->collide != COLLIDE_NONE) collide_init(&col, &scene, a);
+    if (a->mode == MODE_POOL) tpool_start(&g_tpool, tpool_nthreads());
+
+    SDL_Thread* th = SDL_CreateThread(export_writer, "mystify-export", &q);
+    if (!th){ fprintf(stderr,"[ERR] SDL_CreateThread: %s\n", SDL_GetError()); exit(1); }
+
+    double t0 = now_ms(), sim_ms = 0.0, conv_ms = 0.0;
+    int n = 0;
+    for (; n<a->frames; n++){
+        double ts = now_ms();
+        if (a->sim == SIM_ANALYTIC) analytic_eval(&an, an.t + 1, a);
+        else scene_update(&scene, a->mode, a->loop, a->winW, a->winH);
+        if (a->collide != COLLIDE_NONE) scene_collide(&col, &scene, a->mode);
+        cpu_raster_frame(&raster, draw);
+        double tc = now_ms();
+        sim_ms += tc - ts;
+        uint8_t* buf = export_acquire(&q);
+        if (!buf) break;
+        tc = now_ms();
+        if (q.fmt == EXPORT_Y4M) export_fill_y4m(&raster.fb, buf);
+        else                     export_fill_ppm(&raster.fb, buf);
+        conv_ms += now_ms() - tc;
+        export_commit(&q);
+        if (a->checkpoint > 0 && (n+1) % a->checkpoint == 0){
+            snap_checkpoint(&snap, (a->sim == SIM_ANALYTIC)? analytic_snapshot(&an, a) : &scene, a,
+                            steps0 + (uint64_t)n + 1, false);
+        }
+    }
+    // Lo que ya esta en cola se escribe; despues el escritor termina
+    SDL_LockMutex(q.lock);
+    q.total = q.produced;
+    SDL_CondBroadcast(q.has_frame);
+    SDL_UnlockMutex(q.lock);
+    SDL_WaitThread(th, NULL);
+    double secs = (now_ms() - t0) / 1000.0;
+
+    printf("[EXPORT] %d frames %dx%d -> %s | %.2f s | %.1f frames/s | %.1f MB/s\n",
+           q.written, q.w, q.h, q.path, secs, (secs>0.0)? q.written/secs : 0.0,
+           (secs>0.0)? (double)q.bytes/(1024.0*1024.0)/secs : 0.0);
+    printf("[EXPORT] por frame: update+raster %.3f ms, conversion %.3f ms, espera de cola %.3f ms\n",
+           n? sim_ms/n : 0.0, n? conv_ms/n : 0.0, n? q.wait_ms/n : 0.0);
+    if (a->fill != FILL_NONE){
+        double fill_ms, fill_mpx;
+        fill_stats(&raster, &fill_ms, &fill_mpx);
+        print_fill(a, fill_ms, fill_mpx);
+    }
+    if (a->sim == SIM_ANALYTIC) analytic_store(&an, &scene, a);
+    printf("[CHECK] seed=%llu%s updates=%llu checksum=%016llx\n", (unsigned long long)a->seed,
+           (a->sim == SIM_ANALYTIC)? " sim=analytic" : "", (unsigned long long)(steps0 + (uint64_t)n),
+           (unsigned long long)scene_checksum(&scene));
+
+    bool failed = q.failed;
+    if (a->save_state){
+        snap_checkpoint(&snap, &scene, a, steps0 + (uint64_t)n, true);
+        if (!snap_writer_stop(&snap)) failed = true;
+        printf("[SNAP] %s | %ld escritas, %ld checkpoints saltados\n", a->save_state, snap.written, snap.skipped);
+    }
+    tpool_stop(&g_tpool);
+    collide_free(&col);
+    cpu_raster_free(&raster);
+    analytic_free(&an);
+    scene_free(&scene);
+    export_close(&q);
+    if (failed) exit(1);
+}
+
+// ---------- Main ----------
+int main(int argc, char** argv){
+    Args args;
+    parse_args(argc, argv, &args);
+    if (args.load_state) snap_apply_args(&args);
+    if (args.autotune) autotune(&args);
+    if (args.trace_path) trace_init(&args);
+
+    // Headless: solo el temporizador; el resto de SDL no necesita video.
+    if (SDL_Init(args.headless? SDL_INIT_TIMER : SDL_INIT_VIDEO) != 0){
+        fprintf(stderr,"[ERR] SDL_Init: %s\n", SDL_GetError()); return 1;
+    }
+
+    SDL_Window* window = NULL;
+    SDL_Surface* offscreen = NULL;
+    SDL_Renderer* renderer = NULL;
+    if (args.headless){
+        // Renderer por software sobre una superficie ARGB en memoria.
+        offscreen = SDL_CreateRGBSurfaceWithFormat(0, args.winW, args.winH, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (!offscreen){ fprintf(stderr,"[ERR] SDL_CreateRGBSurfaceWithFormat: %s\n", SDL_GetError()); SDL_Quit(); return 1; }
+        renderer = SDL_CreateSoftwareRenderer(offscreen);
+        if (!renderer){ fprintf(stderr,"[ERR] SDL_CreateSoftwareRenderer: %s\n", SDL_GetError()); SDL_FreeSurface(offscreen); SDL_Quit(); return 1; }
+    } else {
+        window = SDL_CreateWindow(
+            "Mystify", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+            args.winW, args.winH, SDL_WINDOW_SHOWN
+        );
+        if (!window){ fprintf(stderr,"[ERR] SDL_CreateWindow: %s\n", SDL_GetError()); SDL_Quit(); return 1; }
+
+        // SDL_RENDERER_PRESENTVSYNC no es obligatorio; usamos acelerado.
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+        if (!renderer){ fprintf(stderr,"[ERR] SDL_CreateRenderer: %s\n", SDL_GetError()); SDL_DestroyWindow(window); SDL_Quit(); return 1; }
+    }
 
-    if (args.bench){
+    if (args.export_path){
+        run_export(renderer, &args);
+    } else if (args.bench){
         bench_all(window, renderer, args);
     } else {
-        (void)run_once(window, renderer, &args);
+        (void)run_once(window, renderer, &args, NULL);
     }
+    trace_dump();
 
     SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    if (window) SDL_DestroyWindow(window);
+    if (offscreen) SDL_FreeSurface(offscreen);
     SDL_Quit();
     return 0;
 }